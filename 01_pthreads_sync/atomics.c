@@ -7,12 +7,14 @@
 #include <stdint.h>
 #include <stdio.h>
 
-// CPU_SET macros:
-#include <sched.h>
 // Threads:
 #include <pthread.h>
 // Atomics:
 #include <stdatomic.h>
+// Persistent worker pool:
+#include "worker-pool.h"
+// Memory ordering ablation:
+#include "memory-ordering.h"
 
 //----------------------
 // Benchmark parameters
@@ -43,7 +45,7 @@ void* thread_func(void* thread_args)
     for (size_t i = 0U; i < NUM_ITERATIONS; ++i)
     {
         // Basic race condition among the threads:
-        atomic_fetch_add_explicit(&var, 1U, memory_order_relaxed);
+        ordered_fetch_add(&var, 1U, memory_order_relaxed);
     }
 
     return NULL;
@@ -53,11 +55,6 @@ void* thread_func(void* thread_args)
 // Thread benchmark
 //------------------
 
-typedef struct {
-    pthread_t tid;
-} THREAD_INFO;
-
-
 int main()
 {
     // Initialize thread data:
@@ -67,62 +64,32 @@ int main()
         args[i].thread_i = i;
     }
 
-    // Spawn threads:
-    THREAD_INFO thread_info[NUM_THREADS];
+    // Start persistent worker pool:
+    WORKER_POOL pool;
+    worker_pool_init(&pool, NUM_THREADS, NUM_HARDWARE_THREAD);
+
+    double start_ns = worker_pool_time_ns();
+
+    // Submit work to pool workers:
     for (size_t i = 0U; i < NUM_THREADS; ++i)
     {
-        // Initialize thread attributes:
-        pthread_attr_t thread_attributes;
-        int ret = pthread_attr_init(&thread_attributes);
-        if (ret != 0)
-        {
-            fprintf(stderr, "Unable to call pthread_attr_init\n");
-            exit(EXIT_FAILURE);
-        }
-
-        // Assign hardware thread to posix thread:
-        cpu_set_t assigned_harts;
-        CPU_ZERO(&assigned_harts);
-
-        // Assumptions:
-        // - There are NUM_HARDWARE_THREAD hardware threads.
-        // - All harts from 0 to are present.
-        size_t hart_i = i % NUM_HARDWARE_THREAD;
-        CPU_SET(hart_i, &assigned_harts);
-
-        // Set thread affinity:
-        ret = pthread_attr_setaffinity_np(&thread_attributes, sizeof(cpu_set_t), &assigned_harts);
-        if (ret != 0)
-        {
-            fprintf(stderr, "Unable to call pthread_attr_setaffinity_np\n");
-            exit(EXIT_FAILURE);
-        }
-
-        // Create POSIX thread:
-        ret = pthread_create(&thread_info[i].tid, &thread_attributes, thread_func, &args[i]);
-        if (ret != 0)
-        {
-            fprintf(stderr, "Unable to create thread\n");
-            exit(EXIT_FAILURE);
-        }
-
-        // Destroy thread attribute object:
-        pthread_attr_destroy(&thread_attributes);
+        worker_pool_submit(&pool, i, thread_func, &args[i]);
     }
 
-    // Wait for all threads to finish execution:
-    for (size_t i = 0; i < NUM_THREADS; ++i)
-    {
-        int ret = pthread_join(thread_info[i].tid, NULL);
-        if (ret != 0)
-        {
-            fprintf(stderr, "Unable to join thread\n");
-            exit(EXIT_FAILURE);
-        }
-    }
+    // Wait for all workers to finish execution:
+    worker_pool_wait(&pool);
+
+    double elapsed_ns = worker_pool_time_ns() - start_ns;
+
+    // Stop worker threads:
+    worker_pool_destroy(&pool);
 
     // Print incremented variable:
     printf("Result of the computation: %u\n", var);
 
+    printf("Memory ordering %s: %.2f Mops/s (%.2f ns/op)\n",
+        MEMORY_ORDERING_NAME, NUM_THREADS * NUM_ITERATIONS / elapsed_ns * 1e3,
+        elapsed_ns / (NUM_THREADS * NUM_ITERATIONS));
+
     return EXIT_SUCCESS;
 }
@@ -0,0 +1,311 @@
+// No copyright. Vladislav Alenik, 2024
+
+// Feature test macro:
+#define _GNU_SOURCE
+
+#include <stdlib.h>
+#include <stdint.h>
+#include <stdbool.h>
+#include <stdio.h>
+
+// Threads:
+#include <pthread.h>
+// Atomic operations:
+#include <stdatomic.h>
+// Process-wide memory barrier:
+#include <linux/membarrier.h>
+#include <sys/syscall.h>
+#include <unistd.h>
+// Persistent worker pool:
+#include "worker-pool.h"
+// Spinlock implementation:
+#include "tas-lock.h"
+
+//----------------------
+// Benchmark parameters
+//----------------------
+
+#define NUM_THREADS 8U
+#define NUM_HARDWARE_THREAD 8U
+
+// Total number of lock acquisitions among all threads:
+const size_t NUM_ITERATIONS = 10000000U;
+
+// Share of acquisitions made by the owner thread (in 0.1% units):
+const size_t OWNER_PERMILLE[] = {1000U, 999U, 990U, 900U, 500U};
+#define NUM_RATIOS (sizeof(OWNER_PERMILLE) / sizeof(OWNER_PERMILLE[0]))
+
+//---------------------------
+// Biased lock
+// NOTE: asymmetric Dekker
+//  with membarrier() as the
+//  heavy side of the fence
+//---------------------------
+
+typedef struct {
+    // Owner's fast path touches only this line:
+    _Alignas(WORKER_POOL_ALIGNMENT) _Atomic uint32_t owner_flag;
+
+    // Non-owner holding (or revoking) the bias:
+    _Alignas(WORKER_POOL_ALIGNMENT) _Atomic uint32_t other_flag;
+
+    // Serializes non-owner threads:
+    TAS_Lock revoke_lock;
+
+    size_t owner_i;
+} BIASED_LOCK;
+
+static inline long membarrier(int cmd, unsigned int flags)
+{
+    return syscall(SYS_membarrier, cmd, flags, 0);
+}
+
+void biased_init(BIASED_LOCK* lock, size_t owner_i)
+{
+    atomic_init(&lock->owner_flag, 0U);
+    atomic_init(&lock->other_flag, 0U);
+    TAS_init(&lock->revoke_lock);
+
+    lock->owner_i = owner_i;
+}
+
+// Process must register before using expedited barriers:
+// NOTE: returns false if the kernel does not support them.
+bool biased_register()
+{
+    long supported = membarrier(MEMBARRIER_CMD_QUERY, 0U);
+    if (supported == -1 || (supported & MEMBARRIER_CMD_PRIVATE_EXPEDITED) == 0)
+    {
+        return false;
+    }
+
+    if (membarrier(MEMBARRIER_CMD_REGISTER_PRIVATE_EXPEDITED, 0U) == -1)
+    {
+        perror("Unable to register for private expedited membarrier");
+        exit(EXIT_FAILURE);
+    }
+
+    return true;
+}
+
+void biased_acquire(BIASED_LOCK* lock, size_t thread_i)
+{
+    if (thread_i == lock->owner_i)
+    {
+        while (true)
+        {
+            // Fast path: plain store and load (no RMW, no fence).
+            atomic_store_explicit(&lock->owner_flag, 1U, memory_order_relaxed);
+
+            // Compiler barrier, the CPU is ordered by membarrier on the slow path:
+            atomic_signal_fence(memory_order_seq_cst);
+
+            if (atomic_load_explicit(&lock->other_flag, memory_order_acquire) == 0U)
+            {
+                return;
+            }
+
+            // Bias is being revoked, step back until the other thread is done:
+            atomic_store_explicit(&lock->owner_flag, 0U, memory_order_release);
+
+            while (atomic_load_explicit(&lock->other_flag, memory_order_acquire) != 0U)
+            {
+                // ASM instruction to ask processor cool down.
+                __asm__ volatile("pause");
+            }
+        }
+    }
+
+    // Slow path: revoke the bias for a single critical section.
+    TAS_acquire(&lock->revoke_lock);
+
+    atomic_store_explicit(&lock->other_flag, 1U, memory_order_relaxed);
+
+    // Full barrier on every running thread of the process (owner included):
+    // either the owner sees other_flag, or we see its owner_flag.
+    if (membarrier(MEMBARRIER_CMD_PRIVATE_EXPEDITED, 0U) == -1)
+    {
+        perror("Unable to execute membarrier");
+        exit(EXIT_FAILURE);
+    }
+
+    while (atomic_load_explicit(&lock->owner_flag, memory_order_acquire) != 0U)
+    {
+        // ASM instruction to ask processor cool down.
+        __asm__ volatile("pause");
+    }
+}
+
+void biased_release(BIASED_LOCK* lock, size_t thread_i)
+{
+    if (thread_i == lock->owner_i)
+    {
+        atomic_store_explicit(&lock->owner_flag, 0U, memory_order_release);
+        return;
+    }
+
+    atomic_store_explicit(&lock->other_flag, 0U, memory_order_release);
+    TAS_release(&lock->revoke_lock);
+}
+
+//------------------
+// Thread execution
+//------------------
+
+typedef enum {
+    LOCK_PTHREAD_MUTEX = 0,
+    LOCK_TAS           = 1,
+    LOCK_BIASED        = 2
+} LOCK_KIND;
+
+const char* LOCK_KIND_NAMES[] = {
+    [LOCK_PTHREAD_MUTEX] = "pthread_mutex",
+    [LOCK_TAS]           = "TAS_Lock",
+    [LOCK_BIASED]        = "biased lock"
+};
+
+typedef struct {
+    size_t thread_i;
+    size_t num_iterations;
+
+    LOCK_KIND kind;
+    pthread_mutex_t* mutex;
+    TAS_Lock* spinlock;
+    BIASED_LOCK* biased;
+
+    double elapsed_ns;
+} THREAD_ARGS;
+
+// Variable to race on:
+uint32_t var = 0U;
+
+void* thread_func(void* thread_args)
+{
+    THREAD_ARGS* args = (THREAD_ARGS*) thread_args;
+
+    double start_ns = worker_pool_time_ns();
+
+    for (size_t i = 0U; i < args->num_iterations; ++i)
+    {
+        // Basic critical section among the threads:
+        switch (args->kind)
+        {
+            case LOCK_PTHREAD_MUTEX:
+                pthread_mutex_lock(args->mutex);
+                var++;
+                pthread_mutex_unlock(args->mutex);
+                break;
+            case LOCK_TAS:
+                TAS_acquire(args->spinlock);
+                var++;
+                TAS_release(args->spinlock);
+                break;
+            case LOCK_BIASED:
+                biased_acquire(args->biased, args->thread_i);
+                var++;
+                biased_release(args->biased, args->thread_i);
+                break;
+        }
+    }
+
+    args->elapsed_ns = worker_pool_time_ns() - start_ns;
+
+    return NULL;
+}
+
+//------------------
+// Thread benchmark
+//------------------
+
+void run_benchmark(WORKER_POOL* pool, LOCK_KIND kind, size_t owner_permille)
+{
+    // Initialize mutual exclusion objects:
+    pthread_mutex_t mutex;
+    pthread_mutex_init(&mutex, NULL);
+
+    TAS_Lock spinlock;
+    TAS_init(&spinlock);
+
+    BIASED_LOCK biased;
+    biased_init(&biased, 0U);
+
+    // Thread#0 is the owner, the rest is split among the others:
+    size_t owner_iterations = NUM_ITERATIONS / 1000U * owner_permille;
+    size_t other_iterations = (NUM_ITERATIONS - owner_iterations) / (NUM_THREADS - 1U);
+
+    // Initialize thread data:
+    THREAD_ARGS args[NUM_THREADS];
+    for (size_t i = 0U; i < NUM_THREADS; ++i)
+    {
+        args[i] = (THREAD_ARGS) {
+            .thread_i       = i,
+            .num_iterations = (i == 0U)? owner_iterations : other_iterations,
+            .kind           = kind,
+            .mutex          = &mutex,
+            .spinlock       = &spinlock,
+            .biased         = &biased,
+            .elapsed_ns     = 0.0
+        };
+    }
+
+    var = 0U;
+
+    double start_ns = worker_pool_time_ns();
+
+    // Submit work to pool workers:
+    for (size_t i = 0U; i < NUM_THREADS; ++i)
+    {
+        worker_pool_submit(pool, i, thread_func, &args[i]);
+    }
+
+    // Wait for all workers to finish execution:
+    worker_pool_wait(pool);
+
+    double elapsed_ns = worker_pool_time_ns() - start_ns;
+
+    size_t expected = owner_iterations + (NUM_THREADS - 1U) * other_iterations;
+
+    printf("%-14s %5.1f%% %9.2f Mops/s %9.1f ns/owner op %11.1f ns/other op %s\n",
+        LOCK_KIND_NAMES[kind], owner_permille / 10.0,
+        expected / elapsed_ns * 1e3,
+        args[0U].elapsed_ns / owner_iterations,
+        (other_iterations == 0U)? 0.0 : args[1U].elapsed_ns / other_iterations,
+        (var == expected)? "ok" : "BROKEN");
+
+    pthread_mutex_destroy(&mutex);
+}
+
+int main()
+{
+    // Start persistent worker pool:
+    WORKER_POOL pool;
+    worker_pool_init(&pool, NUM_THREADS, NUM_HARDWARE_THREAD);
+
+    // Baselines do not depend on membarrier support:
+    bool biased_supported = biased_register();
+    if (!biased_supported)
+    {
+        fprintf(stderr, "MEMBARRIER_CMD_PRIVATE_EXPEDITED is not supported, skipping biased lock\n");
+    }
+
+    printf("%-14s %6s %16s %21s %23s %s\n",
+        "Lock", "Owner", "Throughput", "Owner latency", "Other latency", "Result");
+
+    for (size_t ratio_i = 0U; ratio_i < NUM_RATIOS; ++ratio_i)
+    {
+        for (LOCK_KIND kind = LOCK_PTHREAD_MUTEX; kind <= LOCK_BIASED; ++kind)
+        {
+            if (kind == LOCK_BIASED && !biased_supported)
+            {
+                continue;
+            }
+
+            run_benchmark(&pool, kind, OWNER_PERMILLE[ratio_i]);
+        }
+    }
+
+    // Stop worker threads:
+    worker_pool_destroy(&pool);
+
+    return EXIT_SUCCESS;
+}
@@ -0,0 +1,593 @@
+// No copyright. Vladislav Alenik, 2024
+
+// Feature test macro:
+#define _GNU_SOURCE
+
+#include <stdlib.h>
+#include <stdint.h>
+#include <stdbool.h>
+#include <stdio.h>
+#include <math.h>
+
+// Threads:
+#include <pthread.h>
+// Atomic operations:
+#include <stdatomic.h>
+// Persistent worker pool:
+#include "worker-pool.h"
+// Spinlock implementation:
+#include "tas-lock.h"
+
+//----------------------
+// Benchmark parameters
+//----------------------
+
+#define NUM_THREADS 8U
+#define NUM_HARDWARE_THREAD 8U
+
+// Number of map operations per thread:
+const size_t NUM_ITERATIONS = 4000000U;
+
+// Keys are taken from [0, KEY_SPACE):
+#define KEY_SPACE (1U << 16U)
+
+#define NUM_BUCKETS (1U << 14U)
+#define NUM_STRIPES 64U
+
+// Share of lookups among all operations (the rest are inserts):
+#define LOOKUP_PERCENT 90U
+
+// Skew of Zipfian key distribution (0.99 is the YCSB default):
+#ifndef ZIPF_EXPONENT
+#define ZIPF_EXPONENT 0.99
+#endif
+
+// Length of pre-generated operation stream replayed by every thread:
+#define OP_STREAM_SIZE (1U << 16U)
+
+// Number of hottest stripes to report:
+#define NUM_HOT_STRIPES 4U
+
+//--------------------
+// Hash map structure
+//--------------------
+
+typedef enum {
+    // Single pthread_mutex for the whole map:
+    MAP_GLOBAL_MUTEX = 0,
+    // Bucket i is protected by TAS spinlock (i % NUM_STRIPES):
+    MAP_STRIPED_SPINLOCK = 1,
+    // Striped spinlocks for writers, lock-free seqlock readers:
+    MAP_SEQLOCK_READS = 2
+} MAP_MODE;
+
+const char* MAP_MODE_NAMES[] = {
+    "global pthread_mutex",
+    "striped TAS_Lock",
+    "seqlock reads"
+};
+
+// NOTE: nodes are never removed, so lock-free readers always traverse valid memory.
+typedef struct NODE {
+    _Atomic uint32_t key;
+    _Atomic uint64_t value;
+    struct NODE* _Atomic next;
+} NODE;
+
+typedef struct {
+    // Odd while the bucket is being modified:
+    _Atomic uint32_t seq;
+    NODE* _Atomic head;
+} BUCKET;
+
+typedef struct {
+    _Alignas(WORKER_POOL_ALIGNMENT) TAS_Lock lock;
+} STRIPE;
+
+typedef struct {
+    MAP_MODE mode;
+
+    pthread_mutex_t global_mutex;
+    STRIPE stripes[NUM_STRIPES];
+
+    BUCKET* buckets;
+
+    // Preallocated nodes (one per key at most):
+    NODE* nodes;
+    _Atomic size_t num_nodes;
+} HASH_MAP;
+
+static inline size_t hash_key(uint32_t key)
+{
+    // Fibonacci hashing scatters neighbouring (hot) keys among buckets:
+    return (size_t) ((key * 0x9E3779B97F4A7C15ULL) >> 32U) % NUM_BUCKETS;
+}
+
+static inline size_t stripe_of(size_t bucket_i)
+{
+    return bucket_i % NUM_STRIPES;
+}
+
+void map_init(HASH_MAP* map, MAP_MODE mode)
+{
+    map->mode = mode;
+
+    pthread_mutex_init(&map->global_mutex, NULL);
+    for (size_t i = 0U; i < NUM_STRIPES; ++i)
+    {
+        TAS_init(&map->stripes[i].lock);
+    }
+
+    map->buckets = calloc(NUM_BUCKETS, sizeof(BUCKET));
+    map->nodes   = calloc(KEY_SPACE, sizeof(NODE));
+    if (map->buckets == NULL || map->nodes == NULL)
+    {
+        fprintf(stderr, "Unable to allocate hash map\n");
+        exit(EXIT_FAILURE);
+    }
+
+    atomic_init(&map->num_nodes, 0U);
+}
+
+void map_free(HASH_MAP* map)
+{
+    pthread_mutex_destroy(&map->global_mutex);
+
+    free(map->buckets);
+    free(map->nodes);
+}
+
+//-----------------------
+// Per-thread statistics
+//-----------------------
+
+typedef struct {
+    uint64_t num_lookups;
+    uint64_t num_hits;
+    uint64_t num_inserts;
+
+    // Lock acquisitions and failed first attempts (or seqlock retries):
+    uint64_t stripe_ops[NUM_STRIPES];
+    uint64_t stripe_contended[NUM_STRIPES];
+} MAP_STATS;
+
+// Lock the stripe of the bucket (or the whole map) and record contention:
+void map_lock(HASH_MAP* map, size_t bucket_i, MAP_STATS* stats)
+{
+    if (map->mode == MAP_GLOBAL_MUTEX)
+    {
+        stats->stripe_ops[0U] += 1U;
+
+        if (pthread_mutex_trylock(&map->global_mutex) != 0)
+        {
+            stats->stripe_contended[0U] += 1U;
+            pthread_mutex_lock(&map->global_mutex);
+        }
+    }
+    else
+    {
+        size_t stripe_i = stripe_of(bucket_i);
+        stats->stripe_ops[stripe_i] += 1U;
+
+        if (!TAS_try_acquire(&map->stripes[stripe_i].lock))
+        {
+            stats->stripe_contended[stripe_i] += 1U;
+            TAS_acquire(&map->stripes[stripe_i].lock);
+        }
+    }
+}
+
+void map_unlock(HASH_MAP* map, size_t bucket_i)
+{
+    if (map->mode == MAP_GLOBAL_MUTEX)
+    {
+        pthread_mutex_unlock(&map->global_mutex);
+    }
+    else
+    {
+        TAS_release(&map->stripes[stripe_of(bucket_i)].lock);
+    }
+}
+
+NODE* bucket_find(BUCKET* bucket, uint32_t key)
+{
+    NODE* node = atomic_load_explicit(&bucket->head, memory_order_acquire);
+    while (node != NULL && atomic_load_explicit(&node->key, memory_order_relaxed) != key)
+    {
+        node = atomic_load_explicit(&node->next, memory_order_acquire);
+    }
+
+    return node;
+}
+
+bool map_lookup(HASH_MAP* map, uint32_t key, uint64_t* value, MAP_STATS* stats)
+{
+    size_t bucket_i = hash_key(key);
+    BUCKET* bucket = &map->buckets[bucket_i];
+
+    stats->num_lookups += 1U;
+
+    if (map->mode != MAP_SEQLOCK_READS)
+    {
+        map_lock(map, bucket_i, stats);
+
+        NODE* node = bucket_find(bucket, key);
+        if (node != NULL)
+        {
+            *value = atomic_load_explicit(&node->value, memory_order_relaxed);
+        }
+
+        map_unlock(map, bucket_i);
+
+        stats->num_hits += (node != NULL);
+        return node != NULL;
+    }
+
+    // Optimistic read, retried if a writer has modified the bucket:
+    size_t stripe_i = stripe_of(bucket_i);
+    stats->stripe_ops[stripe_i] += 1U;
+
+    while (true)
+    {
+        uint32_t seq_before = atomic_load_explicit(&bucket->seq, memory_order_acquire);
+        if (seq_before % 2U == 1U)
+        {
+            stats->stripe_contended[stripe_i] += 1U;
+
+            // ASM instruction to ask processor cool down.
+            __asm__ volatile("pause");
+            continue;
+        }
+
+        NODE* node = bucket_find(bucket, key);
+        uint64_t read_value = (node != NULL)? atomic_load_explicit(&node->value, memory_order_relaxed) : 0U;
+
+        // Order data reads before sequence re-check:
+        atomic_thread_fence(memory_order_acquire);
+
+        if (atomic_load_explicit(&bucket->seq, memory_order_relaxed) == seq_before)
+        {
+            *value = read_value;
+
+            stats->num_hits += (node != NULL);
+            return node != NULL;
+        }
+
+        stats->stripe_contended[stripe_i] += 1U;
+    }
+}
+
+void map_insert(HASH_MAP* map, uint32_t key, uint64_t value, MAP_STATS* stats)
+{
+    size_t bucket_i = hash_key(key);
+    BUCKET* bucket = &map->buckets[bucket_i];
+
+    stats->num_inserts += 1U;
+
+    map_lock(map, bucket_i, stats);
+
+    // Open write section for seqlock readers:
+    uint32_t seq = atomic_load_explicit(&bucket->seq, memory_order_relaxed);
+    if (map->mode == MAP_SEQLOCK_READS)
+    {
+        atomic_store_explicit(&bucket->seq, seq + 1U, memory_order_relaxed);
+        atomic_thread_fence(memory_order_release);
+    }
+
+    NODE* node = bucket_find(bucket, key);
+    if (node != NULL)
+    {
+        atomic_store_explicit(&node->value, value, memory_order_relaxed);
+    }
+    else
+    {
+        node = &map->nodes[atomic_fetch_add_explicit(&map->num_nodes, 1U, memory_order_relaxed)];
+
+        atomic_store_explicit(&node->key, key, memory_order_relaxed);
+        atomic_store_explicit(&node->value, value, memory_order_relaxed);
+        atomic_store_explicit(&node->next, atomic_load_explicit(&bucket->head, memory_order_relaxed), memory_order_relaxed);
+
+        // Publish initialized node:
+        atomic_store_explicit(&bucket->head, node, memory_order_release);
+    }
+
+    // Close write section:
+    if (map->mode == MAP_SEQLOCK_READS)
+    {
+        atomic_store_explicit(&bucket->seq, seq + 2U, memory_order_release);
+    }
+
+    map_unlock(map, bucket_i);
+}
+
+//-------------------
+// Key distributions
+//-------------------
+
+typedef enum {
+    KEYS_UNIFORM = 0,
+    KEYS_ZIPFIAN = 1
+} KEY_DISTRIBUTION;
+
+const char* KEY_DISTRIBUTION_NAMES[] = {
+    "uniform",
+    "zipfian"
+};
+
+static inline uint64_t xorshift(uint64_t* state)
+{
+    uint64_t x = *state;
+    x ^= x << 13U;
+    x ^= x >> 7U;
+    x ^= x << 17U;
+    *state = x;
+
+    return x;
+}
+
+// Operation encoding: key in the low bits, insert flag in the top bit:
+#define OP_INSERT_FLAG (1U << 31U)
+
+void generate_op_stream(uint32_t* ops, KEY_DISTRIBUTION distribution, const double* zipf_cdf, uint64_t seed)
+{
+    uint64_t state = 0x9E3779B97F4A7C15ULL * (seed + 1U);
+
+    for (size_t i = 0U; i < OP_STREAM_SIZE; ++i)
+    {
+        uint32_t key;
+        if (distribution == KEYS_UNIFORM)
+        {
+            key = xorshift(&state) % KEY_SPACE;
+        }
+        else
+        {
+            // Inverse transform sampling (rank 0 is the hottest key):
+            double u = (double) (xorshift(&state) >> 11U) / (double) (1ULL << 53U);
+
+            size_t lo = 0U;
+            size_t hi = KEY_SPACE - 1U;
+            while (lo < hi)
+            {
+                size_t mid = (lo + hi) / 2U;
+                if (zipf_cdf[mid] < u)
+                {
+                    lo = mid + 1U;
+                }
+                else
+                {
+                    hi = mid;
+                }
+            }
+
+            key = lo;
+        }
+
+        bool is_insert = xorshift(&state) % 100U >= LOOKUP_PERCENT;
+        ops[i] = key | (is_insert? OP_INSERT_FLAG : 0U);
+    }
+}
+
+double* build_zipf_cdf()
+{
+    double* cdf = calloc(KEY_SPACE, sizeof(double));
+    if (cdf == NULL)
+    {
+        fprintf(stderr, "Unable to allocate Zipf CDF table\n");
+        exit(EXIT_FAILURE);
+    }
+
+    double sum = 0.0;
+    for (size_t rank = 0U; rank < KEY_SPACE; ++rank)
+    {
+        sum += 1.0 / pow((double) (rank + 1U), ZIPF_EXPONENT);
+        cdf[rank] = sum;
+    }
+
+    for (size_t rank = 0U; rank < KEY_SPACE; ++rank)
+    {
+        cdf[rank] /= sum;
+    }
+
+    return cdf;
+}
+
+//------------------
+// Thread execution
+//------------------
+
+typedef struct {
+    size_t thread_i;
+    HASH_MAP* map;
+    const uint32_t* ops;
+
+    MAP_STATS stats;
+    uint64_t checksum;
+} THREAD_ARGS;
+
+void* thread_func(void* thread_args)
+{
+    THREAD_ARGS* args = (THREAD_ARGS*) thread_args;
+
+    uint64_t checksum = 0U;
+    for (size_t i = 0U; i < NUM_ITERATIONS; ++i)
+    {
+        uint32_t op  = args->ops[i % OP_STREAM_SIZE];
+        uint32_t key = op & ~OP_INSERT_FLAG;
+
+        if (op & OP_INSERT_FLAG)
+        {
+            map_insert(args->map, key, i, &args->stats);
+        }
+        else
+        {
+            uint64_t value;
+            if (map_lookup(args->map, key, &value, &args->stats))
+            {
+                checksum += value;
+            }
+        }
+    }
+
+    args->checksum = checksum;
+
+    return NULL;
+}
+
+//------------------
+// Thread benchmark
+//------------------
+
+void report_hot_stripes(const MAP_STATS* total, size_t num_stripes)
+{
+    uint64_t all_ops = 0U;
+    uint64_t all_contended = 0U;
+    for (size_t i = 0U; i < num_stripes; ++i)
+    {
+        all_ops       += total->stripe_ops[i];
+        all_contended += total->stripe_contended[i];
+    }
+
+    printf("  contended:  %5.2f%% of %lu lock/read sections\n",
+        100.0 * all_contended / (all_ops? all_ops : 1U), all_ops);
+
+    if (num_stripes == 1U)
+    {
+        return;
+    }
+
+    // Selection of hottest stripes (by contention):
+    bool reported[NUM_STRIPES] = {false};
+    for (size_t hot_i = 0U; hot_i < NUM_HOT_STRIPES; ++hot_i)
+    {
+        size_t max_i = num_stripes;
+        for (size_t i = 0U; i < num_stripes; ++i)
+        {
+            if (!reported[i] && (max_i == num_stripes ||
+                total->stripe_contended[i] > total->stripe_contended[max_i]))
+            {
+                max_i = i;
+            }
+        }
+
+        reported[max_i] = true;
+
+        printf("  hot stripe #%02zu: %5.1f%% of contention, %5.2f%% of sections (fair share %.2f%%)\n",
+            max_i,
+            100.0 * total->stripe_contended[max_i] / (all_contended? all_contended : 1U),
+            100.0 * total->stripe_ops[max_i] / (all_ops? all_ops : 1U),
+            100.0 / num_stripes);
+    }
+}
+
+void run_benchmark(WORKER_POOL* pool, MAP_MODE mode, KEY_DISTRIBUTION distribution, uint32_t** ops)
+{
+    HASH_MAP map;
+    map_init(&map, mode);
+
+    // Pre-populate the map with every second key:
+    MAP_STATS populate_stats = {0};
+    for (uint32_t key = 0U; key < KEY_SPACE; key += 2U)
+    {
+        map_insert(&map, key, key, &populate_stats);
+    }
+
+    // Initialize thread data:
+    THREAD_ARGS args[NUM_THREADS];
+    for (size_t i = 0U; i < NUM_THREADS; ++i)
+    {
+        args[i] = (THREAD_ARGS) {.thread_i = i, .map = &map, .ops = ops[i]};
+    }
+
+    double start_ns = worker_pool_time_ns();
+
+    // Submit work to pool workers:
+    for (size_t i = 0U; i < NUM_THREADS; ++i)
+    {
+        worker_pool_submit(pool, i, thread_func, &args[i]);
+    }
+
+    // Wait for all workers to finish execution:
+    worker_pool_wait(pool);
+
+    double elapsed_s = (worker_pool_time_ns() - start_ns) / 1e9;
+
+    // Sum up statistics:
+    MAP_STATS total = {0};
+    uint64_t checksum = 0U;
+    for (size_t i = 0U; i < NUM_THREADS; ++i)
+    {
+        total.num_lookups += args[i].stats.num_lookups;
+        total.num_hits    += args[i].stats.num_hits;
+        total.num_inserts += args[i].stats.num_inserts;
+
+        for (size_t stripe_i = 0U; stripe_i < NUM_STRIPES; ++stripe_i)
+        {
+            total.stripe_ops[stripe_i]       += args[i].stats.stripe_ops[stripe_i];
+            total.stripe_contended[stripe_i] += args[i].stats.stripe_contended[stripe_i];
+        }
+
+        checksum += args[i].checksum;
+    }
+
+    printf("[%s, %s keys]\n", MAP_MODE_NAMES[mode], KEY_DISTRIBUTION_NAMES[distribution]);
+    printf("  throughput: %7.2f Mops/s (lookups %.2f Mops/s, inserts %.2f Mops/s)\n",
+        (total.num_lookups + total.num_inserts) / elapsed_s / 1e6,
+        total.num_lookups / elapsed_s / 1e6,
+        total.num_inserts / elapsed_s / 1e6);
+    printf("  hit rate:   %5.2f%%, keys in map %zu, checksum %lu\n",
+        100.0 * total.num_hits / total.num_lookups,
+        atomic_load(&map.num_nodes), checksum);
+
+    report_hot_stripes(&total, (mode == MAP_GLOBAL_MUTEX)? 1U : NUM_STRIPES);
+
+    map_free(&map);
+}
+
+int main()
+{
+    // Generate per-thread operation streams:
+    double* zipf_cdf = build_zipf_cdf();
+
+    uint32_t* ops[2U][NUM_THREADS];
+    for (size_t distribution = KEYS_UNIFORM; distribution <= KEYS_ZIPFIAN; ++distribution)
+    {
+        for (size_t i = 0U; i < NUM_THREADS; ++i)
+        {
+            ops[distribution][i] = calloc(OP_STREAM_SIZE, sizeof(uint32_t));
+            if (ops[distribution][i] == NULL)
+            {
+                fprintf(stderr, "Unable to allocate operation stream\n");
+                exit(EXIT_FAILURE);
+            }
+
+            generate_op_stream(ops[distribution][i], distribution, zipf_cdf, i);
+        }
+    }
+
+    // Start persistent worker pool:
+    WORKER_POOL pool;
+    worker_pool_init(&pool, NUM_THREADS, NUM_HARDWARE_THREAD);
+
+    for (size_t distribution = KEYS_UNIFORM; distribution <= KEYS_ZIPFIAN; ++distribution)
+    {
+        for (size_t mode = MAP_GLOBAL_MUTEX; mode <= MAP_SEQLOCK_READS; ++mode)
+        {
+            run_benchmark(&pool, mode, distribution, ops[distribution]);
+        }
+    }
+
+    // Stop worker threads:
+    worker_pool_destroy(&pool);
+
+    for (size_t distribution = KEYS_UNIFORM; distribution <= KEYS_ZIPFIAN; ++distribution)
+    {
+        for (size_t i = 0U; i < NUM_THREADS; ++i)
+        {
+            free(ops[distribution][i]);
+        }
+    }
+
+    free(zipf_cdf);
+
+    return EXIT_SUCCESS;
+}
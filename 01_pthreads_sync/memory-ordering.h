@@ -0,0 +1,97 @@
+// No copyright. Vladislav Alenik, 2024
+#ifndef MSUSEM_MEMORY_ORDERING
+#define MSUSEM_MEMORY_ORDERING
+
+// Atomic operations:
+#include <stdatomic.h>
+
+//----------------------------------------
+// Memory ordering ablation
+// NOTE: select with
+//  "-DMEMORY_ORDERING=MEMORY_ORDERING_X"
+//----------------------------------------
+
+// Orderings written in the source code:
+#define MEMORY_ORDERING_DEFAULT  0
+// Every operation is sequentially consistent:
+#define MEMORY_ORDERING_SEQ_CST  1
+// Loads are acquire, stores are release, RMW are acq_rel:
+#define MEMORY_ORDERING_ACQ_REL  2
+// Relaxed operations surrounded by atomic_thread_fence():
+#define MEMORY_ORDERING_FENCES   3
+// Relaxed operations surrounded by compiler-only barriers:
+// NOTE: correct only on TSO hardware (x86), breaks on ARM/POWER.
+#define MEMORY_ORDERING_COMPILER 4
+
+#ifndef MEMORY_ORDERING
+#define MEMORY_ORDERING MEMORY_ORDERING_DEFAULT
+#endif
+
+#if MEMORY_ORDERING == MEMORY_ORDERING_DEFAULT
+    #define MEMORY_ORDERING_NAME "default"
+
+    #define ordered_load(ptr, order) \
+        atomic_load_explicit(ptr, order)
+    #define ordered_store(ptr, value, order) \
+        atomic_store_explicit(ptr, value, order)
+    #define ordered_fetch_add(ptr, value, order) \
+        atomic_fetch_add_explicit(ptr, value, order)
+
+#elif MEMORY_ORDERING == MEMORY_ORDERING_SEQ_CST
+    #define MEMORY_ORDERING_NAME "seq_cst"
+
+    #define ordered_load(ptr, order) \
+        atomic_load_explicit(ptr, memory_order_seq_cst)
+    #define ordered_store(ptr, value, order) \
+        atomic_store_explicit(ptr, value, memory_order_seq_cst)
+    #define ordered_fetch_add(ptr, value, order) \
+        atomic_fetch_add_explicit(ptr, value, memory_order_seq_cst)
+
+#elif MEMORY_ORDERING == MEMORY_ORDERING_ACQ_REL
+    #define MEMORY_ORDERING_NAME "acq_rel"
+
+    #define ordered_load(ptr, order) \
+        atomic_load_explicit(ptr, memory_order_acquire)
+    #define ordered_store(ptr, value, order) \
+        atomic_store_explicit(ptr, value, memory_order_release)
+    #define ordered_fetch_add(ptr, value, order) \
+        atomic_fetch_add_explicit(ptr, value, memory_order_acq_rel)
+
+#elif MEMORY_ORDERING == MEMORY_ORDERING_FENCES || MEMORY_ORDERING == MEMORY_ORDERING_COMPILER
+    #if MEMORY_ORDERING == MEMORY_ORDERING_FENCES
+        #define MEMORY_ORDERING_NAME "relaxed+fences"
+        #define ordered_fence(order) atomic_thread_fence(order)
+    #else
+        #define MEMORY_ORDERING_NAME "relaxed+compiler"
+        #define ordered_fence(order) atomic_signal_fence(order)
+    #endif
+
+    // Acquire barrier after the load:
+    #define ordered_load(ptr, order)                                                           \
+        ({                                                                                     \
+            __auto_type loaded = atomic_load_explicit(ptr, memory_order_relaxed);              \
+            ordered_fence(memory_order_acquire);                                               \
+            loaded;                                                                            \
+        })
+
+    // Release barrier before the store:
+    #define ordered_store(ptr, value, order)                                                   \
+        do {                                                                                   \
+            ordered_fence(memory_order_release);                                               \
+            atomic_store_explicit(ptr, value, memory_order_relaxed);                           \
+        } while (0)
+
+    // Both barriers around the RMW:
+    #define ordered_fetch_add(ptr, value, order)                                               \
+        ({                                                                                     \
+            ordered_fence(memory_order_release);                                               \
+            __auto_type fetched = atomic_fetch_add_explicit(ptr, value, memory_order_relaxed); \
+            ordered_fence(memory_order_acquire);                                               \
+            fetched;                                                                           \
+        })
+
+#else
+    #error "Unknown MEMORY_ORDERING value"
+#endif
+
+#endif // MSUSEM_MEMORY_ORDERING
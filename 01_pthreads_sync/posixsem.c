@@ -7,13 +7,13 @@
 #include <stdint.h>
 #include <stdio.h>
 
-// CPU_SET macros:
-#include <sched.h>
 // Threads:
 #include <pthread.h>
 // POSIX semaphores:
 #include <sys/stat.h>
 #include <semaphore.h>
+// Persistent worker pool:
+#include "worker-pool.h"
 
 //----------------------
 // Benchmark parameters
@@ -69,10 +69,6 @@ void* thread_func(void* thread_args)
 // Thread benchmark
 //------------------
 
-typedef struct {
-    pthread_t tid;
-} THREAD_INFO;
-
 int main()
 {
     // Initialize POSIX semaphore:
@@ -89,59 +85,21 @@ int main()
         };
     }
 
-    // Spawn threads:
-    THREAD_INFO thread_info[NUM_THREADS];
+    // Start persistent worker pool:
+    WORKER_POOL pool;
+    worker_pool_init(&pool, NUM_THREADS, NUM_HARDWARE_THREAD);
+
+    // Submit work to pool workers:
     for (size_t i = 0U; i < NUM_THREADS; ++i)
     {
-        // Initialize thread attributes:
-        pthread_attr_t thread_attributes;
-        int ret = pthread_attr_init(&thread_attributes);
-        if (ret != 0)
-        {
-            fprintf(stderr, "Unable to call pthread_attr_init\n");
-            exit(EXIT_FAILURE);
-        }
-
-        // Assign hardware thread to posix thread:
-        cpu_set_t assigned_harts;
-        CPU_ZERO(&assigned_harts);
-
-        // Assumptions:
-        // - There are NUM_HARDWARE_THREAD hardware threads.
-        // - All harts from 0 to are present.
-        size_t hart_i = i % NUM_HARDWARE_THREAD;
-        CPU_SET(hart_i, &assigned_harts);
-
-        // Set thread affinity:
-        ret = pthread_attr_setaffinity_np(&thread_attributes, sizeof(cpu_set_t), &assigned_harts);
-        if (ret != 0)
-        {
-            fprintf(stderr, "Unable to call pthread_attr_setaffinity_np\n");
-            exit(EXIT_FAILURE);
-        }
-
-        // Create POSIX thread:
-        ret = pthread_create(&thread_info[i].tid, &thread_attributes, thread_func, &args[i]);
-        if (ret != 0)
-        {
-            fprintf(stderr, "Unable to create thread\n");
-            exit(EXIT_FAILURE);
-        }
-
-        // Destroy thread attribute object:
-        pthread_attr_destroy(&thread_attributes);
+        worker_pool_submit(&pool, i, thread_func, &args[i]);
     }
 
-    // Wait for all threads to finish execution:
-    for (size_t i = 0; i < NUM_THREADS; ++i)
-    {
-        int ret = pthread_join(thread_info[i].tid, NULL);
-        if (ret != 0)
-        {
-            fprintf(stderr, "Unable to join thread\n");
-            exit(EXIT_FAILURE);
-        }
-    }
+    // Wait for all workers to finish execution:
+    worker_pool_wait(&pool);
+
+    // Stop worker threads:
+    worker_pool_destroy(&pool);
 
     // Print incremented variable:
     printf("Result of the computation: %u\n", var);
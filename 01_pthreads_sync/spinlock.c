@@ -7,12 +7,14 @@
 #include <stdint.h>
 #include <stdio.h>
 
-// CPU_SET macros:
-#include <sched.h>
 // Threads:
 #include <pthread.h>
 // Atomic operations:
 #include <stdatomic.h>
+// Persistent worker pool:
+#include "worker-pool.h"
+// Spinlock implementation:
+#include "tas-lock.h"
 
 //----------------------
 // Benchmark parameters
@@ -23,34 +25,6 @@
 
 const size_t NUM_ITERATIONS = 10000000U;
 
-//-------------------------
-// Spinlock implementation
-//-------------------------
-
-typedef struct
-{
-    atomic_flag lock_taken;
-} TAS_Lock;
-
-void TAS_init(TAS_Lock* lock)
-{
-    atomic_flag_clear_explicit(&lock->lock_taken, memory_order_release);
-}
-
-void TAS_acquire(TAS_Lock* lock)
-{
-    while (atomic_flag_test_and_set_explicit(&lock->lock_taken, memory_order_acquire) != 0)
-    {
-        // ASM instruction to ask processor cool down.
-        __asm__ volatile("pause");
-    }
-}
-
-void TAS_release(TAS_Lock* lock)
-{
-    atomic_flag_clear_explicit(&lock->lock_taken, memory_order_release);
-}
-
 //------------------
 // Thread execution
 //------------------
@@ -86,11 +60,6 @@ void* thread_func(void* thread_args)
 // Thread benchmark
 //------------------
 
-typedef struct {
-    pthread_t tid;
-} THREAD_INFO;
-
-
 int main()
 {
     // Initialize mutual exclusion object:
@@ -105,59 +74,21 @@ int main()
         args[i].spinlock = &spinlock;
     }
 
-    // Spawn threads:
-    THREAD_INFO thread_info[NUM_THREADS];
+    // Start persistent worker pool:
+    WORKER_POOL pool;
+    worker_pool_init(&pool, NUM_THREADS, NUM_HARDWARE_THREAD);
+
+    // Submit work to pool workers:
     for (size_t i = 0U; i < NUM_THREADS; ++i)
     {
-        // Initialize thread attributes:
-        pthread_attr_t thread_attributes;
-        int ret = pthread_attr_init(&thread_attributes);
-        if (ret != 0)
-        {
-            fprintf(stderr, "Unable to call pthread_attr_init\n");
-            exit(EXIT_FAILURE);
-        }
-
-        // Assign hardware thread to posix thread:
-        cpu_set_t assigned_harts;
-        CPU_ZERO(&assigned_harts);
-
-        // Assumptions:
-        // - There are NUM_HARDWARE_THREAD hardware threads.
-        // - All harts from 0 to are present.
-        size_t hart_i = i % NUM_HARDWARE_THREAD;
-        CPU_SET(hart_i, &assigned_harts);
-
-        // Set thread affinity:
-        ret = pthread_attr_setaffinity_np(&thread_attributes, sizeof(cpu_set_t), &assigned_harts);
-        if (ret != 0)
-        {
-            fprintf(stderr, "Unable to call pthread_attr_setaffinity_np\n");
-            exit(EXIT_FAILURE);
-        }
-
-        // Create POSIX thread:
-        ret = pthread_create(&thread_info[i].tid, &thread_attributes, thread_func, &args[i]);
-        if (ret != 0)
-        {
-            fprintf(stderr, "Unable to create thread\n");
-            exit(EXIT_FAILURE);
-        }
-
-        // Destroy thread attribute object:
-        pthread_attr_destroy(&thread_attributes);
+        worker_pool_submit(&pool, i, thread_func, &args[i]);
     }
 
-    // Wait for all threads to finish execution:
-    for (size_t i = 0; i < NUM_THREADS; ++i)
-    {
-        int ret = pthread_join(thread_info[i].tid, NULL);
-        if (ret != 0)
-        {
-            fprintf(stderr, "Unable to join thread\n");
-            exit(EXIT_FAILURE);
-        }
-    }
+    // Wait for all workers to finish execution:
+    worker_pool_wait(&pool);
+
+    // Stop worker threads:
+    worker_pool_destroy(&pool);
 
     // Print incremented variable:
     printf("Result of the computation: %u\n", var);
@@ -0,0 +1,598 @@
+// No copyright. Vladislav Alenik, 2024
+
+// Feature test macro:
+#define _GNU_SOURCE
+
+#include <stdlib.h>
+#include <stdint.h>
+#include <stdbool.h>
+#include <stdio.h>
+
+// Threads:
+#include <pthread.h>
+// sched_yield:
+#include <sched.h>
+// Atomic operations:
+#include <stdatomic.h>
+// Persistent worker pool:
+#include "worker-pool.h"
+
+//----------------------
+// Benchmark parameters
+//----------------------
+
+#define NUM_THREADS 8U
+#define NUM_HARDWARE_THREAD 8U
+
+// Number of transfers per thread:
+const size_t NUM_ITERATIONS = 500000U;
+
+// Fewer accounts mean more conflicts:
+const size_t NUM_ACCOUNTS[] = {8U, 1024U, 65536U};
+#define NUM_CONTENTION_LEVELS (sizeof(NUM_ACCOUNTS) / sizeof(NUM_ACCOUNTS[0]))
+
+#define INITIAL_BALANCE 1000U
+#define MAX_TRANSFER 100U
+
+//-----------------------------------
+// Word-based STM (TL2)
+// NOTE: "Transactional Locking II",
+//  Dice, Shalev and Shavit, DISC'06
+//-----------------------------------
+
+// Versioned write locks, shared by all words hashed to the same entry:
+#define STM_LOCK_TABLE_BITS 16U
+#define STM_LOCK_TABLE_SIZE (1U << STM_LOCK_TABLE_BITS)
+
+// Maximal sizes of read and write sets:
+#define STM_MAX_READS  16U
+#define STM_MAX_WRITES 16U
+
+// Versioned lock layout: (version << 1) | locked.
+#define STM_LOCKED 1ULL
+
+// Number of consecutive aborts before giving the CPU to a (preempted) lock owner:
+#define STM_ABORTS_BEFORE_YIELD 64U
+
+typedef struct {
+    // Global version clock:
+    _Alignas(WORKER_POOL_ALIGNMENT) _Atomic uint64_t clock;
+
+    _Atomic uint64_t* locks;
+} STM;
+
+typedef struct {
+    _Atomic uint64_t* addr;
+    _Atomic uint64_t* lock;
+    uint64_t value;
+
+    // Lock value before acquisition by commit (if acquired by this entry):
+    bool acquired;
+    uint64_t old_lock;
+} STM_WRITE;
+
+typedef struct {
+    STM* stm;
+
+    // Snapshot of the global clock at transaction start:
+    uint64_t read_version;
+
+    _Atomic uint64_t* read_set[STM_MAX_READS];
+    size_t num_reads;
+
+    STM_WRITE write_set[STM_MAX_WRITES];
+    size_t num_writes;
+
+    // Aborts since the last successful commit:
+    uint32_t num_retries;
+
+    // Statistics:
+    uint64_t num_commits;
+    uint64_t num_aborts;
+} STM_TX;
+
+void stm_init(STM* stm)
+{
+    atomic_init(&stm->clock, 0U);
+
+    stm->locks = calloc(STM_LOCK_TABLE_SIZE, sizeof(_Atomic uint64_t));
+    if (stm->locks == NULL)
+    {
+        fprintf(stderr, "Unable to allocate STM lock table\n");
+        exit(EXIT_FAILURE);
+    }
+}
+
+void stm_free(STM* stm)
+{
+    free(stm->locks);
+}
+
+void stm_tx_init(STM_TX* tx, STM* stm)
+{
+    tx->stm = stm;
+
+    tx->num_reads  = 0U;
+    tx->num_writes = 0U;
+
+    tx->num_retries = 0U;
+    tx->num_commits = 0U;
+    tx->num_aborts  = 0U;
+}
+
+static inline _Atomic uint64_t* stm_lock_for(STM* stm, _Atomic uint64_t* addr)
+{
+    // Multiplicative hashing spreads strided addresses over the table:
+    return &stm->locks[(((uintptr_t) addr >> 3U) * 0x9E3779B97F4A7C15ULL) >> (64U - STM_LOCK_TABLE_BITS)];
+}
+
+void stm_begin(STM_TX* tx)
+{
+    tx->read_version = atomic_load_explicit(&tx->stm->clock, memory_order_acquire);
+
+    tx->num_reads  = 0U;
+    tx->num_writes = 0U;
+}
+
+// Drop the transaction after a conflict:
+void stm_abort(STM_TX* tx)
+{
+    tx->num_aborts += 1U;
+
+    if (++tx->num_retries % STM_ABORTS_BEFORE_YIELD == 0U)
+    {
+        sched_yield();
+    }
+    else
+    {
+        // ASM instruction to ask processor cool down.
+        __asm__ volatile("pause");
+    }
+}
+
+// NOTE: returns false if the transaction must be aborted.
+bool stm_read(STM_TX* tx, _Atomic uint64_t* addr, uint64_t* value)
+{
+    // Read own writes:
+    for (size_t i = 0U; i < tx->num_writes; ++i)
+    {
+        if (tx->write_set[i].addr == addr)
+        {
+            *value = tx->write_set[i].value;
+            return true;
+        }
+    }
+
+    _Atomic uint64_t* lock = stm_lock_for(tx->stm, addr);
+
+    // Lock-value-lock sandwich gives a consistent snapshot of the word:
+    uint64_t lock_before = atomic_load_explicit(lock, memory_order_acquire);
+    uint64_t read_value  = atomic_load_explicit(addr, memory_order_acquire);
+    uint64_t lock_after  = atomic_load_explicit(lock, memory_order_relaxed);
+
+    if ((lock_before & STM_LOCKED) != 0U || lock_before != lock_after ||
+        (lock_before >> 1U) > tx->read_version)
+    {
+        return false;
+    }
+
+    if (tx->num_reads == STM_MAX_READS)
+    {
+        fprintf(stderr, "STM read set overflow\n");
+        exit(EXIT_FAILURE);
+    }
+
+    tx->read_set[tx->num_reads++] = lock;
+
+    *value = read_value;
+    return true;
+}
+
+// Buffer the write until commit:
+void stm_write(STM_TX* tx, _Atomic uint64_t* addr, uint64_t value)
+{
+    for (size_t i = 0U; i < tx->num_writes; ++i)
+    {
+        if (tx->write_set[i].addr == addr)
+        {
+            tx->write_set[i].value = value;
+            return;
+        }
+    }
+
+    if (tx->num_writes == STM_MAX_WRITES)
+    {
+        fprintf(stderr, "STM write set overflow\n");
+        exit(EXIT_FAILURE);
+    }
+
+    tx->write_set[tx->num_writes++] = (STM_WRITE) {
+        .addr     = addr,
+        .lock     = stm_lock_for(tx->stm, addr),
+        .value    = value,
+        .acquired = false,
+        .old_lock = 0U
+    };
+}
+
+// Find lock value from before this transaction acquired it (if it did):
+static inline bool stm_owned_lock(STM_TX* tx, _Atomic uint64_t* lock, uint64_t* old_lock)
+{
+    for (size_t i = 0U; i < tx->num_writes; ++i)
+    {
+        if (tx->write_set[i].acquired && tx->write_set[i].lock == lock)
+        {
+            *old_lock = tx->write_set[i].old_lock;
+            return true;
+        }
+    }
+
+    return false;
+}
+
+void stm_release_locks(STM_TX* tx)
+{
+    for (size_t i = 0U; i < tx->num_writes; ++i)
+    {
+        if (tx->write_set[i].acquired)
+        {
+            atomic_store_explicit(tx->write_set[i].lock, tx->write_set[i].old_lock, memory_order_release);
+            tx->write_set[i].acquired = false;
+        }
+    }
+}
+
+// NOTE: returns false if the transaction has been aborted.
+bool stm_commit(STM_TX* tx)
+{
+    // Read-only transactions are already consistent:
+    if (tx->num_writes == 0U)
+    {
+        tx->num_retries  = 0U;
+        tx->num_commits += 1U;
+        return true;
+    }
+
+    // Commit-time locking of the write set:
+    for (size_t i = 0U; i < tx->num_writes; ++i)
+    {
+        STM_WRITE* write = &tx->write_set[i];
+
+        uint64_t old_lock;
+        if (stm_owned_lock(tx, write->lock, &old_lock))
+        {
+            // Lock is shared with another word of the write set:
+            continue;
+        }
+
+        uint64_t lock = atomic_load_explicit(write->lock, memory_order_relaxed);
+        if ((lock & STM_LOCKED) != 0U ||
+            !atomic_compare_exchange_strong_explicit(write->lock, &lock, lock | STM_LOCKED,
+                memory_order_acquire, memory_order_relaxed))
+        {
+            stm_release_locks(tx);
+            stm_abort(tx);
+            return false;
+        }
+
+        write->acquired = true;
+        write->old_lock = lock;
+    }
+
+    uint64_t write_version = atomic_fetch_add_explicit(&tx->stm->clock, 1U, memory_order_acq_rel) + 1U;
+
+    // Validate the read set (unless no one has committed since stm_begin):
+    if (write_version != tx->read_version + 1U)
+    {
+        for (size_t i = 0U; i < tx->num_reads; ++i)
+        {
+            uint64_t lock = atomic_load_explicit(tx->read_set[i], memory_order_acquire);
+
+            if ((lock & STM_LOCKED) != 0U && !stm_owned_lock(tx, tx->read_set[i], &lock))
+            {
+                stm_release_locks(tx);
+                stm_abort(tx);
+                return false;
+            }
+
+            if ((lock >> 1U) > tx->read_version)
+            {
+                stm_release_locks(tx);
+                stm_abort(tx);
+                return false;
+            }
+        }
+    }
+
+    // Locked bits must become visible before new values, or readers may accept a torn snapshot:
+    atomic_thread_fence(memory_order_release);
+
+    // Write back and release locks with the new version:
+    for (size_t i = 0U; i < tx->num_writes; ++i)
+    {
+        atomic_store_explicit(tx->write_set[i].addr, tx->write_set[i].value, memory_order_relaxed);
+    }
+
+    for (size_t i = 0U; i < tx->num_writes; ++i)
+    {
+        if (tx->write_set[i].acquired)
+        {
+            atomic_store_explicit(tx->write_set[i].lock, write_version << 1U, memory_order_release);
+            tx->write_set[i].acquired = false;
+        }
+    }
+
+    tx->num_retries  = 0U;
+    tx->num_commits += 1U;
+    return true;
+}
+
+//---------------
+// Bank accounts
+//---------------
+
+typedef enum {
+    BANK_GLOBAL_LOCK = 0,
+    // Per-account mutexes taken in the order of account indices:
+    BANK_TWO_LOCKS   = 1,
+    BANK_STM         = 2
+} BANK_MODE;
+
+const char* BANK_MODE_NAMES[] = {
+    [BANK_GLOBAL_LOCK] = "global lock",
+    [BANK_TWO_LOCKS]   = "ordered 2-lock",
+    [BANK_STM]         = "TL2 STM"
+};
+
+typedef struct {
+    _Alignas(WORKER_POOL_ALIGNMENT) pthread_mutex_t mutex;
+    _Atomic uint64_t balance;
+} ACCOUNT;
+
+typedef struct {
+    BANK_MODE mode;
+
+    size_t num_accounts;
+    ACCOUNT* accounts;
+
+    pthread_mutex_t global_mutex;
+    STM stm;
+} BANK;
+
+void bank_init(BANK* bank, BANK_MODE mode, size_t num_accounts)
+{
+    bank->mode = mode;
+    bank->num_accounts = num_accounts;
+
+    bank->accounts = aligned_alloc(WORKER_POOL_ALIGNMENT, num_accounts * sizeof(ACCOUNT));
+    if (bank->accounts == NULL)
+    {
+        fprintf(stderr, "Unable to allocate %zu accounts\n", num_accounts);
+        exit(EXIT_FAILURE);
+    }
+
+    for (size_t i = 0U; i < num_accounts; ++i)
+    {
+        pthread_mutex_init(&bank->accounts[i].mutex, NULL);
+        atomic_init(&bank->accounts[i].balance, INITIAL_BALANCE);
+    }
+
+    pthread_mutex_init(&bank->global_mutex, NULL);
+    stm_init(&bank->stm);
+}
+
+void bank_free(BANK* bank)
+{
+    for (size_t i = 0U; i < bank->num_accounts; ++i)
+    {
+        pthread_mutex_destroy(&bank->accounts[i].mutex);
+    }
+
+    pthread_mutex_destroy(&bank->global_mutex);
+    stm_free(&bank->stm);
+
+    free(bank->accounts);
+}
+
+// Move the amount if there is enough money on the source account:
+static inline void transfer_unlocked(ACCOUNT* from, ACCOUNT* to, uint64_t amount)
+{
+    uint64_t from_balance = atomic_load_explicit(&from->balance, memory_order_relaxed);
+    if (from_balance >= amount)
+    {
+        atomic_store_explicit(&from->balance, from_balance - amount, memory_order_relaxed);
+        atomic_store_explicit(&to->balance,
+            atomic_load_explicit(&to->balance, memory_order_relaxed) + amount, memory_order_relaxed);
+    }
+}
+
+void bank_transfer(BANK* bank, STM_TX* tx, size_t from_i, size_t to_i, uint64_t amount)
+{
+    ACCOUNT* from = &bank->accounts[from_i];
+    ACCOUNT* to   = &bank->accounts[to_i];
+
+    switch (bank->mode)
+    {
+        case BANK_GLOBAL_LOCK:
+        {
+            pthread_mutex_lock(&bank->global_mutex);
+            transfer_unlocked(from, to, amount);
+            pthread_mutex_unlock(&bank->global_mutex);
+            break;
+        }
+        case BANK_TWO_LOCKS:
+        {
+            // Global lock order prevents deadlocks:
+            ACCOUNT* first  = (from_i < to_i)? from : to;
+            ACCOUNT* second = (from_i < to_i)? to : from;
+
+            pthread_mutex_lock(&first->mutex);
+            pthread_mutex_lock(&second->mutex);
+
+            transfer_unlocked(from, to, amount);
+
+            pthread_mutex_unlock(&second->mutex);
+            pthread_mutex_unlock(&first->mutex);
+            break;
+        }
+        case BANK_STM:
+        {
+            while (true)
+            {
+                stm_begin(tx);
+
+                uint64_t from_balance;
+                uint64_t to_balance;
+                if (!stm_read(tx, &from->balance, &from_balance) ||
+                    !stm_read(tx, &to->balance, &to_balance))
+                {
+                    stm_abort(tx);
+                    continue;
+                }
+
+                if (from_balance >= amount)
+                {
+                    stm_write(tx, &from->balance, from_balance - amount);
+                    stm_write(tx, &to->balance, to_balance + amount);
+                }
+
+                if (stm_commit(tx))
+                {
+                    break;
+                }
+            }
+            break;
+        }
+    }
+}
+
+//------------------
+// Thread execution
+//------------------
+
+typedef struct {
+    size_t thread_i;
+    BANK* bank;
+    STM_TX tx;
+} THREAD_ARGS;
+
+static inline uint64_t xorshift(uint64_t* state)
+{
+    uint64_t x = *state;
+    x ^= x << 13U;
+    x ^= x >> 7U;
+    x ^= x << 17U;
+    *state = x;
+
+    return x;
+}
+
+void* thread_func(void* thread_args)
+{
+    THREAD_ARGS* args = (THREAD_ARGS*) thread_args;
+    BANK* bank = args->bank;
+
+    uint64_t rng_state = 0x9E3779B97F4A7C15ULL * (args->thread_i + 1U);
+
+    for (size_t i = 0U; i < NUM_ITERATIONS; ++i)
+    {
+        size_t from_i = xorshift(&rng_state) % bank->num_accounts;
+        size_t to_i   = xorshift(&rng_state) % (bank->num_accounts - 1U);
+        if (to_i >= from_i)
+        {
+            to_i += 1U;
+        }
+
+        uint64_t amount = 1U + xorshift(&rng_state) % MAX_TRANSFER;
+
+        bank_transfer(bank, &args->tx, from_i, to_i, amount);
+    }
+
+    return NULL;
+}
+
+//------------------
+// Thread benchmark
+//------------------
+
+bool run_benchmark(WORKER_POOL* pool, BANK_MODE mode, size_t num_accounts, size_t num_threads)
+{
+    BANK bank;
+    bank_init(&bank, mode, num_accounts);
+
+    // Initialize thread data:
+    THREAD_ARGS args[NUM_THREADS];
+    for (size_t i = 0U; i < num_threads; ++i)
+    {
+        args[i].thread_i = i;
+        args[i].bank     = &bank;
+        stm_tx_init(&args[i].tx, &bank.stm);
+    }
+
+    double start_ns = worker_pool_time_ns();
+
+    // Submit work to pool workers:
+    for (size_t i = 0U; i < num_threads; ++i)
+    {
+        worker_pool_submit(pool, i, thread_func, &args[i]);
+    }
+
+    // Wait for all workers to finish execution:
+    worker_pool_wait(pool);
+
+    double elapsed_ns = worker_pool_time_ns() - start_ns;
+
+    // Transfers must preserve total amount of money:
+    uint64_t total_balance = 0U;
+    for (size_t i = 0U; i < num_accounts; ++i)
+    {
+        total_balance += atomic_load(&bank.accounts[i].balance);
+    }
+
+    bool balanced = (total_balance == (uint64_t) num_accounts * INITIAL_BALANCE);
+
+    uint64_t num_commits = 0U;
+    uint64_t num_aborts  = 0U;
+    for (size_t i = 0U; i < num_threads; ++i)
+    {
+        num_commits += args[i].tx.num_commits;
+        num_aborts  += args[i].tx.num_aborts;
+    }
+
+    printf("%-15s %8zu %7zu %9.2f Mops/s %9.2f%% %s\n",
+        BANK_MODE_NAMES[mode], num_accounts, num_threads,
+        (double) num_threads * NUM_ITERATIONS / elapsed_ns * 1e3,
+        (mode == BANK_STM)? 100.0 * num_aborts / (num_commits + num_aborts) : 0.0,
+        balanced? "ok" : "BROKEN");
+
+    bank_free(&bank);
+
+    return balanced;
+}
+
+int main()
+{
+    // Start persistent worker pool:
+    WORKER_POOL pool;
+    worker_pool_init(&pool, NUM_THREADS, NUM_HARDWARE_THREAD);
+
+    printf("%-15s %8s %7s %16s %10s %s\n", "Mode", "Accounts", "Threads", "Throughput", "Aborts", "Total");
+
+    bool balanced = true;
+
+    for (size_t level = 0U; level < NUM_CONTENTION_LEVELS; ++level)
+    {
+        for (size_t num_threads = 1U; num_threads <= NUM_THREADS; num_threads *= 2U)
+        {
+            for (BANK_MODE mode = BANK_GLOBAL_LOCK; mode <= BANK_STM; ++mode)
+            {
+                balanced &= run_benchmark(&pool, mode, NUM_ACCOUNTS[level], num_threads);
+            }
+        }
+    }
+
+    // Stop worker threads:
+    worker_pool_destroy(&pool);
+
+    return balanced? EXIT_SUCCESS : EXIT_FAILURE;
+}
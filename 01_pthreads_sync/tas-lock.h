@@ -0,0 +1,44 @@
+// No copyright. Vladislav Alenik, 2024
+#ifndef MSUSEM_TAS_LOCK
+#define MSUSEM_TAS_LOCK
+
+#include <stdbool.h>
+
+// Atomic operations:
+#include <stdatomic.h>
+
+//-------------------------
+// Spinlock implementation
+//-------------------------
+
+typedef struct
+{
+    atomic_flag lock_taken;
+} TAS_Lock;
+
+void TAS_init(TAS_Lock* lock)
+{
+    atomic_flag_clear_explicit(&lock->lock_taken, memory_order_release);
+}
+
+void TAS_acquire(TAS_Lock* lock)
+{
+    while (atomic_flag_test_and_set_explicit(&lock->lock_taken, memory_order_acquire) != 0)
+    {
+        // ASM instruction to ask processor cool down.
+        __asm__ volatile("pause");
+    }
+}
+
+// Single acquisition attempt (used to detect contention):
+bool TAS_try_acquire(TAS_Lock* lock)
+{
+    return atomic_flag_test_and_set_explicit(&lock->lock_taken, memory_order_acquire) == 0;
+}
+
+void TAS_release(TAS_Lock* lock)
+{
+    atomic_flag_clear_explicit(&lock->lock_taken, memory_order_release);
+}
+
+#endif // MSUSEM_TAS_LOCK
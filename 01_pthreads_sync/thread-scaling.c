@@ -0,0 +1,257 @@
+// No copyright. Vladislav Alenik, 2024
+
+// Feature test macro:
+#define _GNU_SOURCE
+
+#include <stdlib.h>
+#include <stdint.h>
+#include <stdio.h>
+
+// Threads:
+#include <pthread.h>
+// POSIX semaphores:
+#include <semaphore.h>
+// Stack arena allocation:
+#include <sys/mman.h>
+// Persistent worker pool:
+#include "worker-pool.h"
+
+//----------------------
+// Benchmark parameters
+//----------------------
+
+#define NUM_HARDWARE_THREAD 8U
+
+// Thread counts up to the 10k-thread mode:
+const size_t NUM_THREADS[] = {8U, 64U, 512U, 4096U, 10000U};
+#define NUM_SCALING_STEPS (sizeof(NUM_THREADS) / sizeof(NUM_THREADS[0]))
+
+// Total number of critical sections split among all threads:
+const size_t NUM_ITERATIONS = 8000000U;
+
+// Small stack for mostly idle threads:
+#define SMALL_STACK_SIZE (64U * 1024U)
+
+//---------------------
+// Stack configuration
+//---------------------
+
+typedef enum {
+    // Default pthread stack (8 MiB + guard page):
+    STACKS_DEFAULT = 0,
+    // Small stacks allocated by pthreads (pthread_attr_setstacksize):
+    STACKS_SMALL   = 1,
+    // Small stacks carved from a single caller-provided mapping (pthread_attr_setstack):
+    STACKS_ARENA   = 2
+} STACK_MODE;
+
+const char* STACK_MODE_NAMES[] = {
+    [STACKS_DEFAULT] = "default",
+    [STACKS_SMALL]   = "64K stacks",
+    [STACKS_ARENA]   = "64K arena"
+};
+
+size_t get_rss_bytes()
+{
+    FILE* statm = fopen("/proc/self/statm", "r");
+    if (statm == NULL)
+    {
+        perror("Unable to open /proc/self/statm");
+        exit(EXIT_FAILURE);
+    }
+
+    size_t total_pages = 0U;
+    size_t rss_pages   = 0U;
+    if (fscanf(statm, "%zu %zu", &total_pages, &rss_pages) != 2)
+    {
+        fprintf(stderr, "Unable to parse /proc/self/statm\n");
+        exit(EXIT_FAILURE);
+    }
+
+    fclose(statm);
+
+    return rss_pages * sysconf(_SC_PAGESIZE);
+}
+
+//------------------
+// Thread execution
+//------------------
+
+typedef struct {
+    size_t num_iterations;
+    pthread_mutex_t* mutex;
+    sem_t* sem;
+} THREAD_ARGS;
+
+// Variable to race on:
+uint32_t var = 0U;
+
+void* mutex_thread_func(void* thread_args)
+{
+    THREAD_ARGS* args = (THREAD_ARGS*) thread_args;
+
+    for (size_t i = 0U; i < args->num_iterations; ++i)
+    {
+        // Basic critical section among the threads:
+        pthread_mutex_lock(args->mutex);
+
+        var++;
+
+        pthread_mutex_unlock(args->mutex);
+    }
+
+    return NULL;
+}
+
+void* sem_thread_func(void* thread_args)
+{
+    THREAD_ARGS* args = (THREAD_ARGS*) thread_args;
+
+    for (size_t i = 0U; i < args->num_iterations; ++i)
+    {
+        // Basic critical section among the threads:
+        int ret = sem_wait(args->sem);
+        if (ret == -1)
+        {
+            fprintf(stderr, "Unable to lock semaphore lock\n");
+            exit(EXIT_FAILURE);
+        }
+
+        var++;
+
+        ret = sem_post(args->sem);
+        if (ret == -1)
+        {
+            fprintf(stderr, "Unable to unlock semaphore lock\n");
+            exit(EXIT_FAILURE);
+        }
+    }
+
+    return NULL;
+}
+
+// Run the same job on every worker and return throughput in Mops/s:
+double measure_throughput(WORKER_POOL* pool, void* (*func)(void*), THREAD_ARGS* args)
+{
+    var = 0U;
+
+    double start_ns = worker_pool_time_ns();
+
+    // Submit work to pool workers:
+    for (size_t i = 0U; i < pool->num_workers; ++i)
+    {
+        worker_pool_submit(pool, i, func, args);
+    }
+
+    // Wait for all workers to finish execution:
+    worker_pool_wait(pool);
+
+    double elapsed_ns = worker_pool_time_ns() - start_ns;
+
+    if (var != args->num_iterations * pool->num_workers)
+    {
+        fprintf(stderr, "Lost updates: %u\n", var);
+        exit(EXIT_FAILURE);
+    }
+
+    return var / elapsed_ns * 1e3;
+}
+
+//------------------
+// Thread benchmark
+//------------------
+
+void run_benchmark(STACK_MODE mode, size_t num_threads, double* base_mutex, double* base_sem)
+{
+    WORKER_POOL_STACKS stacks = {.stack_size = 0U, .stack_arena = NULL};
+
+    if (mode != STACKS_DEFAULT)
+    {
+        stacks.stack_size = SMALL_STACK_SIZE;
+    }
+
+    size_t rss_before = get_rss_bytes();
+
+    // Stack arena is created by the caller:
+    size_t arena_size = num_threads * SMALL_STACK_SIZE;
+    if (mode == STACKS_ARENA)
+    {
+        stacks.stack_arena = mmap(NULL, arena_size, PROT_READ|PROT_WRITE,
+            MAP_PRIVATE|MAP_ANONYMOUS|MAP_NORESERVE, -1, 0);
+        if (stacks.stack_arena == MAP_FAILED)
+        {
+            perror("Unable to map stack arena");
+            exit(EXIT_FAILURE);
+        }
+    }
+
+    // Start persistent worker pool:
+    WORKER_POOL pool;
+    worker_pool_init_stacks(&pool, num_threads, NUM_HARDWARE_THREAD, &stacks);
+
+    size_t rss_after = get_rss_bytes();
+
+    // RSS may shrink between samples, so do not let the difference wrap:
+    size_t rss_delta = (rss_after > rss_before)? rss_after - rss_before : 0U;
+
+    // Initialize synchronization primitives:
+    pthread_mutex_t mutex;
+    pthread_mutex_init(&mutex, NULL);
+
+    sem_t sem;
+    sem_init(&sem, 0 /* sem is not shared */, 1U /* init value */);
+
+    THREAD_ARGS args = {
+        .num_iterations = NUM_ITERATIONS / num_threads,
+        .mutex          = &mutex,
+        .sem            = &sem
+    };
+
+    double mutex_mops = measure_throughput(&pool, mutex_thread_func, &args);
+    double sem_mops   = measure_throughput(&pool, sem_thread_func, &args);
+
+    // Degradation is relative to the smallest thread count:
+    if (*base_mutex == 0.0)
+    {
+        *base_mutex = mutex_mops;
+        *base_sem   = sem_mops;
+    }
+
+    printf("%-10s %7zu %10.1f ms %8.1f KiB %10.1f MiB %8.2f Mops/s (x%.2f) %8.2f Mops/s (x%.2f)\n",
+        STACK_MODE_NAMES[mode], num_threads,
+        pool.startup_ns / 1e6,
+        (double) rss_delta / num_threads / 1024.0,
+        (double) rss_delta / (1024.0 * 1024.0),
+        mutex_mops, mutex_mops / *base_mutex,
+        sem_mops, sem_mops / *base_sem);
+
+    // Stop worker threads:
+    worker_pool_destroy(&pool);
+
+    pthread_mutex_destroy(&mutex);
+    sem_destroy(&sem);
+
+    if (mode == STACKS_ARENA)
+    {
+        munmap(stacks.stack_arena, arena_size);
+    }
+}
+
+int main()
+{
+    printf("%-10s %7s %13s %12s %14s %24s %24s\n",
+        "Stacks", "Threads", "Creation", "RSS/thread", "RSS total", "Mutex", "Semaphore");
+
+    for (STACK_MODE mode = STACKS_DEFAULT; mode <= STACKS_ARENA; ++mode)
+    {
+        double base_mutex = 0.0;
+        double base_sem   = 0.0;
+
+        for (size_t step = 0U; step < NUM_SCALING_STEPS; ++step)
+        {
+            run_benchmark(mode, NUM_THREADS[step], &base_mutex, &base_sem);
+        }
+    }
+
+    return EXIT_SUCCESS;
+}
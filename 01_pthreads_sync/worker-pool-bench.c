@@ -0,0 +1,191 @@
+// No copyright. Vladislav Alenik, 2024
+
+// Feature test macro:
+#define _GNU_SOURCE
+
+#include "worker-pool.h"
+
+// Resource usage (page faults):
+#include <sys/resource.h>
+
+//----------------------
+// Benchmark parameters
+//----------------------
+
+#define NUM_THREADS 8U
+#define NUM_HARDWARE_THREAD 8U
+
+const size_t NUM_ROUNDS = 10000U;
+
+// Stack depth touched by every job (to expose page faults in fresh stacks):
+#define JOB_STACK_DEPTH (32U * 1024U)
+
+//------------------
+// Thread execution
+//------------------
+
+typedef struct {
+    size_t thread_i;
+} THREAD_ARGS;
+
+__attribute__((noinline))
+void* thread_func(void* thread_args)
+{
+    THREAD_ARGS* args = (THREAD_ARGS*) thread_args;
+
+    // Short job using a bit of stack:
+    uint8_t stack_area[JOB_STACK_DEPTH];
+    for (size_t i = 0U; i < JOB_STACK_DEPTH; i += 4096U)
+    {
+        stack_area[i] = args->thread_i;
+    }
+
+    // Compiler barrier prevents the stores from being optimized out:
+    __asm__ volatile("" : : "r"(stack_area) : "memory");
+
+    return NULL;
+}
+
+//-------------------------------
+// Baseline: pthread_create/join
+//-------------------------------
+
+typedef struct {
+    pthread_t tid;
+} THREAD_INFO;
+
+void spawn_and_join_threads(THREAD_ARGS* args)
+{
+    // Spawn threads:
+    THREAD_INFO thread_info[NUM_THREADS];
+    for (size_t i = 0U; i < NUM_THREADS; ++i)
+    {
+        // Initialize thread attributes:
+        pthread_attr_t thread_attributes;
+        int ret = pthread_attr_init(&thread_attributes);
+        if (ret != 0)
+        {
+            fprintf(stderr, "Unable to call pthread_attr_init\n");
+            exit(EXIT_FAILURE);
+        }
+
+        // Assign hardware thread to posix thread:
+        cpu_set_t assigned_harts;
+        CPU_ZERO(&assigned_harts);
+
+        // Assumptions:
+        // - There are NUM_HARDWARE_THREAD hardware threads.
+        // - All harts from 0 to are present.
+        size_t hart_i = i % NUM_HARDWARE_THREAD;
+        CPU_SET(hart_i, &assigned_harts);
+
+        // Set thread affinity:
+        ret = pthread_attr_setaffinity_np(&thread_attributes, sizeof(cpu_set_t), &assigned_harts);
+        if (ret != 0)
+        {
+            fprintf(stderr, "Unable to call pthread_attr_setaffinity_np\n");
+            exit(EXIT_FAILURE);
+        }
+
+        // Create POSIX thread:
+        ret = pthread_create(&thread_info[i].tid, &thread_attributes, thread_func, &args[i]);
+        if (ret != 0)
+        {
+            fprintf(stderr, "Unable to create thread\n");
+            exit(EXIT_FAILURE);
+        }
+
+        // Destroy thread attribute object:
+        pthread_attr_destroy(&thread_attributes);
+    }
+
+    // Wait for all threads to finish execution:
+    for (size_t i = 0; i < NUM_THREADS; ++i)
+    {
+        int ret = pthread_join(thread_info[i].tid, NULL);
+        if (ret != 0)
+        {
+            fprintf(stderr, "Unable to join thread\n");
+            exit(EXIT_FAILURE);
+        }
+    }
+}
+
+//------------------
+// Thread benchmark
+//------------------
+
+long get_minor_faults()
+{
+    struct rusage usage;
+    getrusage(RUSAGE_SELF, &usage);
+
+    return usage.ru_minflt;
+}
+
+int main()
+{
+    // Initialize thread data:
+    THREAD_ARGS args[NUM_THREADS];
+    for (size_t i = 0U; i < NUM_THREADS; ++i)
+    {
+        args[i].thread_i = i;
+    }
+
+    // Measure fresh threads for every round:
+    long start_faults = get_minor_faults();
+    double start_ns = worker_pool_time_ns();
+
+    for (size_t round = 0U; round < NUM_ROUNDS; ++round)
+    {
+        spawn_and_join_threads(args);
+    }
+
+    double pthread_ns  = (worker_pool_time_ns() - start_ns) / NUM_ROUNDS;
+    double pthread_flt = (double) (get_minor_faults() - start_faults) / NUM_ROUNDS;
+
+    // Measure persistent pool (start-up is reported separately):
+    start_faults = get_minor_faults();
+
+    WORKER_POOL pool;
+    worker_pool_init(&pool, NUM_THREADS, NUM_HARDWARE_THREAD);
+
+    long startup_faults = get_minor_faults() - start_faults;
+
+    start_faults = get_minor_faults();
+    start_ns = worker_pool_time_ns();
+
+    for (size_t round = 0U; round < NUM_ROUNDS; ++round)
+    {
+        // Submit work to pool workers:
+        for (size_t i = 0U; i < NUM_THREADS; ++i)
+        {
+            worker_pool_submit(&pool, i, thread_func, &args[i]);
+        }
+
+        // Wait for all workers to finish execution:
+        worker_pool_wait(&pool);
+    }
+
+    double pool_ns  = (worker_pool_time_ns() - start_ns) / NUM_ROUNDS;
+    double pool_flt = (double) (get_minor_faults() - start_faults) / NUM_ROUNDS;
+
+    printf("Pool start-up:         %10.1f us (%ld minor faults)\n", pool.startup_ns / 1e3, startup_faults);
+    printf("pthread_create round:  %10.1f us (%.1f minor faults)\n", pthread_ns / 1e3, pthread_flt);
+    printf("Pool dispatch round:   %10.1f us (%.1f minor faults)\n", pool_ns / 1e3, pool_flt);
+    printf("Dispatch speed-up:     %10.1fx\n", pthread_ns / pool_ns);
+
+    // Pool start-up never pays off if dispatch is not faster than thread creation:
+    if (pthread_ns > pool_ns)
+    {
+        printf("Break-even rounds:     %10.1f\n", pool.startup_ns / (pthread_ns - pool_ns));
+    }
+    else
+    {
+        printf("Break-even rounds:     %10s\n", "n/a");
+    }
+
+    worker_pool_destroy(&pool);
+
+    return EXIT_SUCCESS;
+}
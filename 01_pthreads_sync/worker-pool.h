@@ -0,0 +1,382 @@
+// No copyright. Vladislav Alenik, 2024
+#ifndef MSUSEM_WORKER_POOL
+#define MSUSEM_WORKER_POOL
+
+// Feature test macro:
+#define _GNU_SOURCE
+
+#include <stdlib.h>
+#include <stdint.h>
+#include <stdbool.h>
+#include <stdio.h>
+#include <string.h>
+#include <limits.h>
+
+// CPU_SET macros:
+#include <sched.h>
+// Threads:
+#include <pthread.h>
+// Atomics:
+#include <stdatomic.h>
+// Futexes:
+#include <linux/futex.h>
+#include <sys/syscall.h>
+#include <unistd.h>
+// Time measurement:
+#include <time.h>
+
+//========================
+// Worker pool parameters
+//========================
+
+#define WORKER_POOL_ALIGNMENT 128U
+
+// Number of polling iterations before falling asleep on a futex:
+// NOTE: spinning is disabled if workers oversubscribe the CPUs.
+#define WORKER_POOL_SPIN_ITERATIONS 4096U
+
+// Amount of worker stack touched before the first job:
+// NOTE: limited to a quarter of the stack for small stacks.
+#define WORKER_POOL_STACK_PREFAULT (64U * 1024U)
+
+//==================================
+// Event: futex with spin-then-park
+//==================================
+
+typedef struct {
+    _Atomic uint32_t value;
+    _Atomic uint32_t num_sleepers;
+} POOL_EVENT;
+
+void pool_event_init(POOL_EVENT* event, uint32_t value)
+{
+    atomic_init(&event->value, value);
+    atomic_init(&event->num_sleepers, 0U);
+}
+
+// Wait until event value differs from old_value and return the new value:
+uint32_t pool_event_wait(POOL_EVENT* event, uint32_t old_value, uint32_t spin_iterations)
+{
+    for (uint32_t iter = 0U; iter < spin_iterations; ++iter)
+    {
+        uint32_t value = atomic_load_explicit(&event->value, memory_order_acquire);
+        if (value != old_value)
+        {
+            return value;
+        }
+
+        // ASM instruction to ask processor cool down.
+        __asm__ volatile("pause");
+    }
+
+    while (true)
+    {
+        // Announce sleeper before the final check (pairs with pool_event_wake):
+        atomic_fetch_add_explicit(&event->num_sleepers, 1U, memory_order_seq_cst);
+
+        uint32_t value = atomic_load_explicit(&event->value, memory_order_seq_cst);
+        if (value == old_value)
+        {
+            // Kernel re-checks the value atomically with going to sleep:
+            syscall(SYS_futex, &event->value, FUTEX_WAIT_PRIVATE, old_value, NULL, NULL, 0);
+
+            value = atomic_load_explicit(&event->value, memory_order_acquire);
+        }
+
+        atomic_fetch_sub_explicit(&event->num_sleepers, 1U, memory_order_relaxed);
+
+        if (value != old_value)
+        {
+            return value;
+        }
+    }
+}
+
+// Wake up sleepers after the value has been modified:
+void pool_event_wake(POOL_EVENT* event)
+{
+    atomic_thread_fence(memory_order_seq_cst);
+
+    if (atomic_load_explicit(&event->num_sleepers, memory_order_relaxed) != 0U)
+    {
+        syscall(SYS_futex, &event->value, FUTEX_WAKE_PRIVATE, INT_MAX, NULL, NULL, 0);
+    }
+}
+
+//========================
+// Persistent worker pool
+//========================
+
+typedef struct WORKER_POOL WORKER_POOL;
+
+typedef struct {
+    // Incremented on each submitted job:
+    _Alignas(WORKER_POOL_ALIGNMENT) POOL_EVENT job_seq;
+
+    void* (*func)(void* arg);
+    void* arg;
+
+    size_t worker_i;
+    WORKER_POOL* pool;
+
+    pthread_t tid;
+} WORKER;
+
+// Stack configuration of pool workers:
+typedef struct {
+    // Size of every worker stack (0 keeps the default one):
+    size_t stack_size;
+
+    // Memory for num_workers stacks of stack_size bytes (NULL to let pthreads allocate):
+    // NOTE: stacks from the arena have no guard pages.
+    void* stack_arena;
+} WORKER_POOL_STACKS;
+
+struct WORKER_POOL {
+    size_t num_workers;
+    WORKER* workers;
+
+    size_t prefault_size;
+
+    // Number of submitted jobs not finished yet:
+    _Alignas(WORKER_POOL_ALIGNMENT) POOL_EVENT num_pending;
+
+    _Atomic bool shutdown;
+
+    uint32_t spin_iterations;
+
+    // Time spent to get all workers pinned, pre-faulted and ready:
+    double startup_ns;
+};
+
+double worker_pool_time_ns()
+{
+    struct timespec time;
+    clock_gettime(CLOCK_MONOTONIC, &time);
+
+    return 1e9 * time.tv_sec + time.tv_nsec;
+}
+
+void worker_pool_finish_job(WORKER_POOL* pool)
+{
+    uint32_t pending = atomic_fetch_sub_explicit(&pool->num_pending.value, 1U, memory_order_acq_rel);
+    if (pending == 1U)
+    {
+        pool_event_wake(&pool->num_pending);
+    }
+}
+
+// Touch stack pages now, so that the first job does not page fault:
+__attribute__((noinline))
+void worker_pool_prefault_stack(size_t prefault_size)
+{
+    uint8_t stack_area[prefault_size + 1U];
+    for (size_t i = 0U; i < prefault_size; i += 4096U)
+    {
+        stack_area[i] = 0U;
+    }
+
+    // Compiler barrier prevents the stores from being optimized out:
+    __asm__ volatile("" : : "r"(stack_area) : "memory");
+}
+
+void* worker_pool_thread_func(void* worker_arg)
+{
+    WORKER* worker = (WORKER*) worker_arg;
+    WORKER_POOL* pool = worker->pool;
+
+    worker_pool_prefault_stack(pool->prefault_size);
+
+    // Report readiness:
+    worker_pool_finish_job(pool);
+
+    uint32_t job_seq = 0U;
+    while (true)
+    {
+        job_seq = pool_event_wait(&worker->job_seq, job_seq, pool->spin_iterations);
+
+        if (atomic_load_explicit(&pool->shutdown, memory_order_acquire))
+        {
+            break;
+        }
+
+        worker->func(worker->arg);
+
+        worker_pool_finish_job(pool);
+    }
+
+    return NULL;
+}
+
+// Wait for all submitted jobs to finish:
+void worker_pool_wait(WORKER_POOL* pool)
+{
+    uint32_t pending;
+    while ((pending = atomic_load_explicit(&pool->num_pending.value, memory_order_acquire)) != 0U)
+    {
+        pool_event_wait(&pool->num_pending, pending, pool->spin_iterations);
+    }
+}
+
+// NOTE: stacks may be NULL to use default stacks.
+void worker_pool_init_stacks(WORKER_POOL* pool, size_t num_workers, size_t num_hardware_threads,
+                             const WORKER_POOL_STACKS* stacks)
+{
+    double start_ns = worker_pool_time_ns();
+
+    pool->num_workers = num_workers;
+
+    size_t stack_size = (stacks == NULL)? 0U : stacks->stack_size;
+
+    // Threads cannot be placed into an arena without knowing their stack size:
+    if (stacks != NULL && stacks->stack_arena != NULL && stack_size == 0U)
+    {
+        fprintf(stderr, "Stack arena requires a non-zero stack size\n");
+        exit(EXIT_FAILURE);
+    }
+
+    pool->prefault_size = (stack_size == 0U || stack_size / 4U > WORKER_POOL_STACK_PREFAULT)?
+        WORKER_POOL_STACK_PREFAULT : stack_size / 4U;
+
+    pool->workers = aligned_alloc(WORKER_POOL_ALIGNMENT, num_workers * sizeof(WORKER));
+    if (pool->workers == NULL)
+    {
+        fprintf(stderr, "Unable to allocate %zu workers\n", num_workers);
+        exit(EXIT_FAILURE);
+    }
+
+    // Every worker reports readiness as a finished job:
+    pool_event_init(&pool->num_pending, num_workers);
+    atomic_init(&pool->shutdown, false);
+
+    // Waiting thread (+1) must not steal CPU time from workers:
+    long num_cpus = sysconf(_SC_NPROCESSORS_ONLN);
+    pool->spin_iterations = (num_workers + 1U <= (size_t) num_cpus)? WORKER_POOL_SPIN_ITERATIONS : 0U;
+
+    for (size_t i = 0U; i < num_workers; ++i)
+    {
+        WORKER* worker = &pool->workers[i];
+
+        pool_event_init(&worker->job_seq, 0U);
+
+        worker->func     = NULL;
+        worker->arg      = NULL;
+        worker->worker_i = i;
+        worker->pool     = pool;
+    }
+
+    // Spawn threads:
+    for (size_t i = 0U; i < num_workers; ++i)
+    {
+        // Initialize thread attributes:
+        pthread_attr_t thread_attributes;
+        int ret = pthread_attr_init(&thread_attributes);
+        if (ret != 0)
+        {
+            fprintf(stderr, "Unable to call pthread_attr_init\n");
+            exit(EXIT_FAILURE);
+        }
+
+        // Assign hardware thread to posix thread:
+        cpu_set_t assigned_harts;
+        CPU_ZERO(&assigned_harts);
+
+        // Assumptions:
+        // - There are num_hardware_threads hardware threads.
+        // - All harts from 0 to are present.
+        size_t hart_i = i % num_hardware_threads;
+        CPU_SET(hart_i, &assigned_harts);
+
+        // Set thread affinity:
+        ret = pthread_attr_setaffinity_np(&thread_attributes, sizeof(cpu_set_t), &assigned_harts);
+        if (ret != 0)
+        {
+            fprintf(stderr, "Unable to call pthread_attr_setaffinity_np\n");
+            exit(EXIT_FAILURE);
+        }
+
+        // Set thread stack:
+        if (stacks != NULL && stacks->stack_arena != NULL)
+        {
+            ret = pthread_attr_setstack(&thread_attributes,
+                (uint8_t*) stacks->stack_arena + i * stack_size, stack_size);
+            if (ret != 0)
+            {
+                fprintf(stderr, "Unable to call pthread_attr_setstack\n");
+                exit(EXIT_FAILURE);
+            }
+        }
+        else if (stack_size != 0U)
+        {
+            ret = pthread_attr_setstacksize(&thread_attributes, stack_size);
+            if (ret != 0)
+            {
+                fprintf(stderr, "Unable to call pthread_attr_setstacksize\n");
+                exit(EXIT_FAILURE);
+            }
+        }
+
+        // Create POSIX thread:
+        ret = pthread_create(&pool->workers[i].tid, &thread_attributes, worker_pool_thread_func, &pool->workers[i]);
+        if (ret != 0)
+        {
+            fprintf(stderr, "Unable to create thread#%zu: %s\n", i, strerror(ret));
+            exit(EXIT_FAILURE);
+        }
+
+        // Destroy thread attribute object:
+        pthread_attr_destroy(&thread_attributes);
+    }
+
+    // Wait for all workers to get ready:
+    worker_pool_wait(pool);
+
+    pool->startup_ns = worker_pool_time_ns() - start_ns;
+}
+
+void worker_pool_init(WORKER_POOL* pool, size_t num_workers, size_t num_hardware_threads)
+{
+    worker_pool_init_stacks(pool, num_workers, num_hardware_threads, NULL);
+}
+
+// Hand a job to the worker:
+// NOTE: worker must be idle (i.e. worker_pool_wait called after the previous job).
+void worker_pool_submit(WORKER_POOL* pool, size_t worker_i, void* (*func)(void*), void* arg)
+{
+    WORKER* worker = &pool->workers[worker_i];
+
+    worker->func = func;
+    worker->arg  = arg;
+
+    atomic_fetch_add_explicit(&pool->num_pending.value, 1U, memory_order_relaxed);
+
+    // Publish job to the worker:
+    atomic_fetch_add_explicit(&worker->job_seq.value, 1U, memory_order_release);
+    pool_event_wake(&worker->job_seq);
+}
+
+void worker_pool_destroy(WORKER_POOL* pool)
+{
+    atomic_store_explicit(&pool->shutdown, true, memory_order_release);
+
+    for (size_t i = 0U; i < pool->num_workers; ++i)
+    {
+        atomic_fetch_add_explicit(&pool->workers[i].job_seq.value, 1U, memory_order_release);
+        pool_event_wake(&pool->workers[i].job_seq);
+    }
+
+    // Wait for all threads to finish execution:
+    for (size_t i = 0U; i < pool->num_workers; ++i)
+    {
+        int ret = pthread_join(pool->workers[i].tid, NULL);
+        if (ret != 0)
+        {
+            fprintf(stderr, "Unable to join thread\n");
+            exit(EXIT_FAILURE);
+        }
+    }
+
+    free(pool->workers);
+}
+
+#endif // MSUSEM_WORKER_POOL
@@ -21,9 +21,10 @@
 // File operations
 //=================
 
-void open_src_file(const char* filename, int* fd, uint32_t* file_size)
+// NOTE: direct I/O bypasses page cache, but requires aligned buffers, offsets and sizes.
+void open_src_file(const char* filename, int* fd, uint64_t* file_size, bool direct)
 {
-    *fd = open(filename, O_RDONLY|O_DIRECT);
+    *fd = open(filename, direct? O_RDONLY|O_DIRECT : O_RDONLY);
     if (*fd == -1)
     {
         fprintf(stderr, "Unable to open source file '%s': errno=%i (%s)",
@@ -42,17 +43,21 @@ void open_src_file(const char* filename, int* fd, uint32_t* file_size)
     *file_size = statbuf.st_size;
 }
 
-void open_dst_file(const char* filename, int* fd, uint32_t src_size)
+void create_dst_file(const char* filename, int* fd)
 {
-    *fd = open(filename, O_WRONLY|O_CREAT|O_TRUNC, 0644);
+    // NOTE: shared writable mappings require the file to be opened for reading too.
+    *fd = open(filename, O_RDWR|O_CREAT|O_TRUNC, 0644);
     if (*fd == -1)
     {
         fprintf(stderr, "Unable to open destination file '%s': errno=%i (%s)",
             filename, errno, strerror(errno));
         exit(EXIT_FAILURE);
     }
+}
 
-    if (fallocate(*fd, 0, 0, src_size) == -1)
+void allocate_dst_file(const char* filename, int fd, uint64_t src_size)
+{
+    if (fallocate(fd, 0, 0, src_size) == -1)
     {
         fprintf(stderr, "Not enough space for file '%s': errno=%i (%s)",
             filename, errno, strerror(errno));
@@ -60,8 +65,25 @@ void open_dst_file(const char* filename, int* fd, uint32_t src_size)
     }
 }
 
+// Extend the file without allocating space, so that holes are preserved:
+void truncate_dst_file(const char* filename, int fd, uint64_t src_size)
+{
+    if (ftruncate(fd, src_size) == -1)
+    {
+        fprintf(stderr, "Unable to truncate file '%s': errno=%i (%s)",
+            filename, errno, strerror(errno));
+        exit(EXIT_FAILURE);
+    }
+}
+
+void open_dst_file(const char* filename, int* fd, uint64_t src_size)
+{
+    create_dst_file(filename, fd);
+    allocate_dst_file(filename, *fd, src_size);
+}
+
 void close_src_dst_files(
-    const char* src_filename, int src_fd, uint32_t src_size,
+    const char* src_filename, int src_fd, uint64_t src_size,
     const char* dst_filename, int dst_fd)
 {
     // Truncate file to specified size:
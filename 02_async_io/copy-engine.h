@@ -0,0 +1,452 @@
+// No copyright. 2024, Vladislav Aleinik
+#ifndef MSUSEM_COPY_ENGINE
+#define MSUSEM_COPY_ENGINE
+
+#include "common.h"
+
+// CPU time measurement:
+#include <sys/resource.h>
+// Reflink ioctls:
+#include <sys/ioctl.h>
+#include <linux/fs.h>
+// Time measurement:
+#include <time.h>
+// Shared counters:
+#include <stdatomic.h>
+// Zero block detection:
+#include "vector-kernels.h"
+
+//=======================
+// Copy engine interface
+//=======================
+
+// Page alignment satisfies O_DIRECT requirements of all block devices:
+#define COPY_BUFFER_ALIGNMENT 4096U
+
+// Use of copy-on-write clones before copying data:
+typedef enum {
+    REFLINK_NEVER  = 0,
+    REFLINK_AUTO   = 1,
+    REFLINK_ALWAYS = 2
+} CopyReflink;
+
+// Optional io_uring features (io-uring engine):
+typedef enum {
+    // Submit read and write of a block as a linked pair:
+    URING_LINK          = 1U << 0,
+    // Kernel thread polls the submission queue:
+    URING_SQPOLL        = 1U << 1,
+    // Register file descriptors of the job with the ring:
+    URING_FIXED_FILES   = 1U << 2,
+    // Open files right into the ring file table, without regular descriptors:
+    URING_DIRECT_FDS    = 1U << 3,
+    // Kernel picks read buffers from a shared pool:
+    URING_BUF_RING      = 1U << 4,
+    // Reap completions in batches:
+    URING_BATCH         = 1U << 5,
+    // Run completion work only when the single issuer enters the kernel:
+    URING_DEFER_TASKRUN = 1U << 6
+} UringFeature;
+
+// Runtime parameters shared by all engines:
+struct CopyConfig
+{
+    // Size of a single I/O request:
+    uint32_t block_size;
+    // Number of requests in flight (asynchronous engines):
+    uint32_t queue_depth;
+    // Number of worker threads (thread-pool engine):
+    uint32_t num_threads;
+    // Read source file with O_DIRECT:
+    bool direct;
+    // Try to clone the file on CoW filesystems (btrfs, XFS):
+    CopyReflink reflink;
+    // Size of the file window mapped at once (mmap engine), 0 for default:
+    uint64_t window_size;
+    // Drop cached source pages before copying:
+    bool cold;
+    // Copy only data extents of the source, preserve holes:
+    bool sparse;
+    // Turn all-zero blocks into holes instead of writing them:
+    bool skip_zeros;
+    // Mask of UringFeature values:
+    uint32_t uring_features;
+    // Idle time before the SQ polling thread sleeps, 0 for kernel default:
+    uint32_t sq_idle_ms;
+    // CPU to pin the SQ polling thread to, -1 for no pinning:
+    int32_t sq_cpu;
+    // Size of the provided buffer pool, 0 for one buffer per request:
+    uint32_t num_buffers;
+    // Number of rings, each copying its own range of the file in a separate thread:
+    uint32_t num_rings;
+};
+
+// Opened files and position of the next block to copy:
+struct CopyJob
+{
+    const char* src_filename;
+    const char* dst_filename;
+
+    int src_fd;
+    int dst_fd;
+
+    uint64_t src_size;
+    uint64_t offset;
+    // End of the copied range (src_size for the whole file):
+    uint64_t end;
+
+    // Copy only data extents found with SEEK_DATA/SEEK_HOLE:
+    bool sparse;
+    // End of the current data extent (whole file for dense copying):
+    uint64_t data_end;
+    // Bytes of holes not copied:
+    uint64_t skipped;
+    // Bytes of all-zero blocks not written (updated by concurrent workers):
+    _Atomic uint64_t zeroed;
+};
+
+struct CopyEngine
+{
+    const char* name;
+
+    // Copy all blocks of the job:
+    void (*copy)(const struct CopyConfig* config, struct CopyJob* job);
+};
+
+void copy_job_init(struct CopyJob* job, int src_fd, int dst_fd, uint64_t src_size, bool sparse)
+{
+    job->src_fd   = src_fd;
+    job->dst_fd   = dst_fd;
+    job->src_size = src_size;
+    job->offset   = 0U;
+    job->end      = src_size;
+
+    job->sparse   = sparse;
+    job->data_end = sparse? 0U : src_size;
+    job->skipped  = 0U;
+    job->zeroed   = 0U;
+}
+
+// Job copying only the [start, end) range of the file of another job:
+void copy_job_init_range(struct CopyJob* range, const struct CopyJob* job, uint64_t start, uint64_t end)
+{
+    copy_job_init(range, job->src_fd, job->dst_fd, job->src_size, job->sparse);
+
+    range->src_filename = job->src_filename;
+    range->dst_filename = job->dst_filename;
+
+    range->offset   = start;
+    range->end      = end;
+    range->data_end = job->sparse? start : end;
+}
+
+// Move the job to the next data extent, return false if only holes are left:
+// NOTE: filesystems without SEEK_DATA support report the whole file as data.
+bool copy_job_seek_data(struct CopyJob* job, uint32_t block_size)
+{
+    off_t data_start = lseek(job->src_fd, job->offset, SEEK_DATA);
+    if (data_start == -1 && errno == ENXIO)
+    {
+        job->skipped += job->end - job->offset;
+        job->offset   = job->end;
+        return false;
+    }
+
+    off_t hole_start = (data_start == -1)? -1 : lseek(job->src_fd, data_start, SEEK_HOLE);
+    if (hole_start == -1)
+    {
+        fprintf(stderr, "Unable to find data extent at %lx: errno=%i (%s)\n",
+            job->offset, errno, strerror(errno));
+        exit(EXIT_FAILURE);
+    }
+
+    // Align the extent to blocks, so that O_DIRECT requirements still hold:
+    uint64_t start = (uint64_t) data_start / block_size * block_size;
+    uint64_t end   = ((uint64_t) hole_start + block_size - 1U) / block_size * block_size;
+
+    if (start < job->offset)
+    {
+        start = job->offset;
+    }
+
+    // Next data extent may be beyond the range:
+    if (start >= job->end)
+    {
+        job->skipped += job->end - job->offset;
+        job->offset   = job->end;
+        return false;
+    }
+
+    job->skipped += start - job->offset;
+    job->offset   = start;
+    job->data_end = (end < job->end)? end : job->end;
+
+    return true;
+}
+
+// Get the next block to copy, return false if there are no blocks left:
+// NOTE: engines read whole block_size (O_DIRECT alignment), but write only the size bytes.
+bool copy_job_next_block(struct CopyJob* job, uint32_t block_size, uint64_t* offset, uint32_t* size)
+{
+    if (job->offset >= job->end)
+    {
+        return false;
+    }
+
+    if (job->offset >= job->data_end && !copy_job_seek_data(job, block_size))
+    {
+        return false;
+    }
+
+    uint64_t bytes_left = job->data_end - job->offset;
+
+    *offset = job->offset;
+    *size   = (bytes_left < block_size)? bytes_left : block_size;
+
+    job->offset += *size;
+
+    return true;
+}
+
+// Allocate buffers suitable for O_DIRECT transfers:
+uint8_t* copy_alloc_buffers(const struct CopyConfig* config, size_t num_buffers)
+{
+    // Size passed to aligned_alloc() must be a multiple of the alignment:
+    size_t size = num_buffers * config->block_size;
+    size = (size + COPY_BUFFER_ALIGNMENT - 1U) / COPY_BUFFER_ALIGNMENT * COPY_BUFFER_ALIGNMENT;
+
+    uint8_t* buffers = (uint8_t*) aligned_alloc(COPY_BUFFER_ALIGNMENT, size);
+    if (buffers == NULL)
+    {
+        fprintf(stderr, "Unable to allocate aligned buffers\n");
+        exit(EXIT_FAILURE);
+    }
+
+    return buffers;
+}
+
+// Check the block read into buffer, return true if it is all zeros and needs no write:
+// NOTE: sparse destination is only truncated, so skipped writes leave holes there.
+bool copy_skip_zero_block(const struct CopyConfig* config, struct CopyJob* job,
+                          const uint8_t* buffer, uint64_t offset, uint32_t size)
+{
+    if (!config->skip_zeros || !vector_is_zero(buffer, size))
+    {
+        return false;
+    }
+
+    // Dense destination is allocated in advance:
+    if (!job->sparse && fallocate(job->dst_fd, FALLOC_FL_PUNCH_HOLE|FALLOC_FL_KEEP_SIZE, offset, size) == -1)
+    {
+        // Fall back to writing zeros on filesystems without hole punching:
+        if (errno == EOPNOTSUPP)
+        {
+            return false;
+        }
+
+        fprintf(stderr, "Unable to punch hole [%lx, %lx): errno=%i (%s)\n",
+            offset, offset + size, errno, strerror(errno));
+        exit(EXIT_FAILURE);
+    }
+
+    atomic_fetch_add_explicit(&job->zeroed, size, memory_order_relaxed);
+    return true;
+}
+
+//==============================
+// Cell state for async engines
+//==============================
+
+typedef enum {
+    BLOCK_IDLE     = 0,
+    BLOCK_IN_READ  = 1,
+    BLOCK_IN_WRITE = 2
+} BlockStage;
+
+// Block transferred by a single queue cell:
+struct BlockStatus
+{
+    BlockStage stage;
+
+    uint64_t offset;
+    uint32_t size;
+};
+
+struct BlockStatus* copy_alloc_block_statuses(uint32_t queue_depth)
+{
+    struct BlockStatus* statuses = calloc(queue_depth, sizeof(struct BlockStatus));
+    if (statuses == NULL)
+    {
+        fprintf(stderr, "Unable to allocate block statuses\n");
+        exit(EXIT_FAILURE);
+    }
+
+    // NOTE: calloc() leaves all cells in BLOCK_IDLE stage.
+    return statuses;
+}
+
+//=========================
+// Reflink (CoW) fast path
+//=========================
+
+// Share source extents with the destination, return the number of cloned bytes:
+uint64_t copy_reflink(const struct CopyConfig* config, const char* engine_name,
+                      int src_fd, int dst_fd, uint64_t src_size)
+{
+    if (config->reflink == REFLINK_NEVER || src_size == 0U)
+    {
+        return 0U;
+    }
+
+    // Clone the whole file as a metadata-only operation:
+    if (ioctl(dst_fd, FICLONE, src_fd) == 0)
+    {
+        return src_size;
+    }
+
+    int clone_errno = errno;
+
+    // Whole-file clone fails on unaligned ranges, but the block-aligned part may still be cloned:
+    struct stat statbuf;
+    if (clone_errno == EINVAL && fstat(src_fd, &statbuf) == 0)
+    {
+        uint64_t aligned_size = src_size / statbuf.st_blksize * statbuf.st_blksize;
+
+        fprintf(stderr, "FICLONE failed (errno=%i: %s), falling back to FICLONERANGE\n",
+            clone_errno, strerror(clone_errno));
+
+        struct file_clone_range range = {
+            .src_fd      = src_fd,
+            .src_offset  = 0U,
+            .src_length  = aligned_size,
+            .dest_offset = 0U
+        };
+
+        if (aligned_size != 0U && ioctl(dst_fd, FICLONERANGE, &range) == 0)
+        {
+            fprintf(stderr, "FICLONERANGE cloned %lu bytes, copying the %lu byte tail with %s\n",
+                aligned_size, src_size - aligned_size, engine_name);
+            return aligned_size;
+        }
+
+        clone_errno = (aligned_size == 0U)? EINVAL : errno;
+        fprintf(stderr, "FICLONERANGE failed (errno=%i: %s), falling back to %s\n",
+            clone_errno, strerror(clone_errno), engine_name);
+    }
+    else
+    {
+        fprintf(stderr, "FICLONE failed (errno=%i: %s), falling back to %s\n",
+            clone_errno, strerror(clone_errno), engine_name);
+    }
+
+    if (config->reflink == REFLINK_ALWAYS)
+    {
+        fprintf(stderr, "Unable to clone file with reflink\n");
+        exit(EXIT_FAILURE);
+    }
+
+    return 0U;
+}
+
+//==================
+// Copy measurement
+//==================
+
+double copy_time_sec()
+{
+    struct timespec time;
+    clock_gettime(CLOCK_MONOTONIC, &time);
+
+    return time.tv_sec + 1e-9 * time.tv_nsec;
+}
+
+// User and system CPU time of all process threads:
+double copy_cpu_time_sec()
+{
+    struct rusage usage;
+    if (getrusage(RUSAGE_SELF, &usage) == -1)
+    {
+        fprintf(stderr, "Unable to get resource usage: errno=%i (%s)\n",
+            errno, strerror(errno));
+        exit(EXIT_FAILURE);
+    }
+
+    return usage.ru_utime.tv_sec + 1e-6 * usage.ru_utime.tv_usec +
+           usage.ru_stime.tv_sec + 1e-6 * usage.ru_stime.tv_usec;
+}
+
+//=====================
+// Main copy procedure
+//=====================
+
+void copy_file(const struct CopyEngine* engine, const struct CopyConfig* config,
+               const char* src_filename, const char* dst_filename)
+{
+    // Open source file and determine it's size:
+    int src_fd;
+    uint64_t src_size;
+    open_src_file(src_filename, &src_fd, &src_size, config->direct);
+
+    // Create the destination file:
+    int dst_fd;
+    create_dst_file(dst_filename, &dst_fd);
+
+    struct CopyJob job;
+    copy_job_init(&job, src_fd, dst_fd, src_size, config->sparse);
+
+    // Engines may reopen the files in their own way:
+    job.src_filename = src_filename;
+    job.dst_filename = dst_filename;
+
+    // Measure copying from the disk instead of the page cache:
+    // NOTE: only clean pages are dropped, so the source should be synced beforehand.
+    if (config->cold)
+    {
+        int advice_ret = posix_fadvise(src_fd, 0, 0, POSIX_FADV_DONTNEED);
+        if (advice_ret != 0)
+        {
+            fprintf(stderr, "Unable to drop cached source pages: errno=%i (%s)\n",
+                advice_ret, strerror(advice_ret));
+            exit(EXIT_FAILURE);
+        }
+    }
+
+    double start_sec     = copy_time_sec();
+    double start_cpu_sec = copy_cpu_time_sec();
+
+    // Cloned part of the file needs no data copying:
+    uint64_t cloned = copy_reflink(config, engine->name, src_fd, dst_fd, src_size);
+    if (cloned != src_size)
+    {
+        if (config->sparse)
+        {
+            // Leave holes unallocated:
+            truncate_dst_file(dst_filename, dst_fd, src_size);
+        }
+        else
+        {
+            // Allocate space on the disk:
+            allocate_dst_file(dst_filename, dst_fd, src_size);
+        }
+
+        job.offset = cloned;
+        engine->copy(config, &job);
+    }
+
+    close_src_dst_files(src_filename, src_fd, src_size, dst_filename, dst_fd);
+
+    double elapsed_sec = copy_time_sec() - start_sec;
+    double cpu_sec     = copy_cpu_time_sec() - start_cpu_sec;
+
+    double mib = src_size / (1024.0 * 1024.0);
+    double gib = mib / 1024.0;
+
+    printf("%s: %.1f MiB in %.3f sec (%.1f MiB/sec), CPU %.3f sec (%.3f sec/GiB), "
+           "%.1f MiB cloned, %.1f MiB of holes skipped, %.1f MiB of zeros not written\n",
+        engine->name, mib, elapsed_sec, mib / elapsed_sec,
+        cpu_sec, (gib == 0.0)? 0.0 : cpu_sec / gib,
+        cloned / (1024.0 * 1024.0), job.skipped / (1024.0 * 1024.0),
+        atomic_load(&job.zeroed) / (1024.0 * 1024.0));
+}
+
+#endif // MSUSEM_COPY_ENGINE
@@ -0,0 +1,318 @@
+// No copyright. 2024, Vladislav Aleinik
+
+#include "copy-engine.h"
+
+// Copy engines:
+#include "sync-engine.h"
+#include "thread-pool-engine.h"
+#include "posix-aio-engine.h"
+#include "linux-aio-engine.h"
+#include "io-uring-engine.h"
+#include "io-uring-splice-engine.h"
+#include "zero-copy-engine.h"
+#include "mmap-engine.h"
+
+// Command line parsing:
+#include <getopt.h>
+
+//===================
+// Available engines
+//===================
+
+const struct CopyEngine* ENGINES[] = {
+    &SYNC_ENGINE,
+    &THREAD_POOL_ENGINE,
+    &POSIX_AIO_ENGINE,
+    &LINUX_AIO_ENGINE,
+    &IO_URING_ENGINE,
+    &IO_URING_SPLICE_ENGINE,
+    &COPY_FILE_RANGE_ENGINE,
+    &SENDFILE_ENGINE,
+    &SPLICE_ENGINE,
+    &MMAP_ENGINE
+};
+
+#define NUM_ENGINES (sizeof(ENGINES) / sizeof(ENGINES[0]))
+
+const struct CopyEngine* find_engine(const char* name)
+{
+    for (size_t i = 0U; i < NUM_ENGINES; ++i)
+    {
+        if (strcmp(ENGINES[i]->name, name) == 0)
+        {
+            return ENGINES[i];
+        }
+    }
+
+    return NULL;
+}
+
+//===================
+// io_uring features
+//===================
+
+struct UringFeatureName
+{
+    const char* name;
+    UringFeature feature;
+};
+
+const struct UringFeatureName URING_FEATURES[] = {
+    {"link",          URING_LINK},
+    {"sqpoll",        URING_SQPOLL},
+    {"fixed-files",   URING_FIXED_FILES},
+    {"direct-fds",    URING_DIRECT_FDS},
+    {"buf-ring",      URING_BUF_RING},
+    {"batch",         URING_BATCH},
+    {"defer-taskrun", URING_DEFER_TASKRUN}
+};
+
+#define NUM_URING_FEATURES (sizeof(URING_FEATURES) / sizeof(URING_FEATURES[0]))
+
+// Parse comma-separated list of features:
+uint32_t parse_uring_features(const char* str)
+{
+    uint32_t features = 0U;
+
+    char* list = strdup(str);
+    for (char* name = strtok(list, ","); name != NULL; name = strtok(NULL, ","))
+    {
+        if (strcmp(name, "none") == 0)
+        {
+            continue;
+        }
+
+        size_t i = 0U;
+        while (i < NUM_URING_FEATURES && strcmp(URING_FEATURES[i].name, name) != 0)
+        {
+            i++;
+        }
+
+        if (i == NUM_URING_FEATURES)
+        {
+            fprintf(stderr, "Unknown io_uring feature '%s'\n", name);
+            exit(EXIT_FAILURE);
+        }
+
+        features |= URING_FEATURES[i].feature;
+    }
+
+    free(list);
+    return features;
+}
+
+//======================
+// Command line options
+//======================
+
+void print_usage()
+{
+    fprintf(stderr,
+        "Usage: copy-tool [options] <src> <dst>\n"
+        "Options:\n"
+        "  -e, --engine=NAME       copy engine (default: io-uring)\n"
+        "  -b, --block-size=BYTES  size of a single I/O request (default: 8K)\n"
+        "  -q, --queue-depth=N     number of requests in flight (default: 64)\n"
+        "  -t, --threads=N         number of thread-pool workers (default: 8)\n"
+        "  -d, --direct            read source with O_DIRECT (default)\n"
+        "  -B, --buffered          read source through page cache\n"
+        "  -r, --reflink=WHEN      clone file on CoW filesystems: auto (default), always, never\n"
+        "  -w, --window=BYTES      size of the file window mapped at once (default: 64M)\n"
+        "  -c, --cold              drop cached source pages before copying\n"
+        "  -s, --sparse            copy only data extents, preserve holes (default)\n"
+        "  -S, --dense             copy all bytes of the source\n"
+        "  -z, --skip-zeros        turn all-zero blocks into holes\n"
+        "  -Z, --write-zeros       write all-zero blocks as data (default)\n"
+        "  -u, --uring=LIST        comma-separated io_uring features (default: none)\n"
+        "  -i, --sq-idle=MS        idle time before the SQ polling thread sleeps, 0 for kernel default (default: 1000)\n"
+        "  -a, --sq-cpu=N          pin the SQ polling thread to CPU N\n"
+        "  -n, --buffers=N         size of the provided buffer pool (default: queue depth)\n"
+        "  -R, --rings=N           split the file among N io_uring rings and threads (default: 1)\n"
+        "Engines:");
+
+    for (size_t i = 0U; i < NUM_ENGINES; ++i)
+    {
+        fprintf(stderr, " %s", ENGINES[i]->name);
+    }
+
+    fprintf(stderr, "\nio_uring features:");
+
+    for (size_t i = 0U; i < NUM_URING_FEATURES; ++i)
+    {
+        fprintf(stderr, " %s", URING_FEATURES[i].name);
+    }
+
+    fprintf(stderr, "\n");
+}
+
+// Parse CPU number:
+int32_t parse_cpu(const char* str, const char* option)
+{
+    char* end;
+    long cpu = strtol(str, &end, 10);
+
+    if (end == str || *end != '\0' || cpu < 0 || cpu >= sysconf(_SC_NPROCESSORS_CONF))
+    {
+        fprintf(stderr, "Invalid value '%s' for option %s\n", str, option);
+        exit(EXIT_FAILURE);
+    }
+
+    return cpu;
+}
+
+// Parse time in milliseconds, 0 is allowed:
+uint32_t parse_ms(const char* str, const char* option)
+{
+    char* end;
+    errno = 0;
+    unsigned long long value = strtoull(str, &end, 10);
+
+    if (end == str || *end != '\0' || errno == ERANGE || value > UINT32_MAX)
+    {
+        fprintf(stderr, "Invalid value '%s' for option %s\n", str, option);
+        exit(EXIT_FAILURE);
+    }
+
+    return value;
+}
+
+// Parse number with optional K/M/G suffix, not greater than max:
+uint64_t parse_size(const char* str, const char* option, uint64_t max)
+{
+    char* end;
+    errno = 0;
+    unsigned long long value = strtoull(str, &end, 10);
+
+    unsigned shift = 0U;
+    switch (*end)
+    {
+        case 'K': case 'k': shift = 10U; end++; break;
+        case 'M': case 'm': shift = 20U; end++; break;
+        case 'G': case 'g': shift = 30U; end++; break;
+        default: break;
+    }
+
+    // Check the range before shifting, so that the value cannot wrap around:
+    if (end == str || *end != '\0' || errno == ERANGE || value == 0U || value > (max >> shift))
+    {
+        fprintf(stderr, "Invalid value '%s' for option %s\n", str, option);
+        exit(EXIT_FAILURE);
+    }
+
+    return value << shift;
+}
+
+//=====================
+// Main copy procedure
+//=====================
+
+int main(int argc, char* argv[])
+{
+    const struct CopyEngine* engine = &IO_URING_ENGINE;
+
+    struct CopyConfig config = {
+        .block_size     = 8192U,
+        .queue_depth    = 64U,
+        .num_threads    = 8U,
+        .direct         = true,
+        .reflink        = REFLINK_AUTO,
+        .window_size    = MMAP_DEFAULT_WINDOW_SIZE,
+        .cold           = false,
+        .sparse         = true,
+        .skip_zeros     = false,
+        .uring_features = 0U,
+        .sq_idle_ms     = 1000U,
+        .sq_cpu         = -1,
+        .num_buffers    = 0U,
+        .num_rings      = 1U
+    };
+
+    const struct option long_options[] = {
+        {"engine",      required_argument, NULL, 'e'},
+        {"block-size",  required_argument, NULL, 'b'},
+        {"queue-depth", required_argument, NULL, 'q'},
+        {"threads",     required_argument, NULL, 't'},
+        {"direct",      no_argument,       NULL, 'd'},
+        {"buffered",    no_argument,       NULL, 'B'},
+        {"reflink",     required_argument, NULL, 'r'},
+        {"window",      required_argument, NULL, 'w'},
+        {"cold",        no_argument,       NULL, 'c'},
+        {"sparse",      no_argument,       NULL, 's'},
+        {"dense",       no_argument,       NULL, 'S'},
+        {"skip-zeros",  no_argument,       NULL, 'z'},
+        {"write-zeros", no_argument,       NULL, 'Z'},
+        {"uring",       required_argument, NULL, 'u'},
+        {"sq-idle",     required_argument, NULL, 'i'},
+        {"sq-cpu",      required_argument, NULL, 'a'},
+        {"buffers",     required_argument, NULL, 'n'},
+        {"rings",       required_argument, NULL, 'R'},
+        {"help",        no_argument,       NULL, 'h'},
+        {NULL,          0,                 NULL,  0 }
+    };
+
+    int opt;
+    while ((opt = getopt_long(argc, argv, "e:b:q:t:dBr:w:csSzZu:i:a:n:R:h", long_options, NULL)) != -1)
+    {
+        switch (opt)
+        {
+            case 'e':
+                engine = find_engine(optarg);
+                if (engine == NULL)
+                {
+                    fprintf(stderr, "Unknown engine '%s'\n", optarg);
+                    print_usage();
+                    exit(EXIT_FAILURE);
+                }
+                break;
+            case 'b': config.block_size  = parse_size(optarg, "--block-size",  UINT32_MAX); break;
+            case 'q': config.queue_depth = parse_size(optarg, "--queue-depth", UINT32_MAX); break;
+            case 't': config.num_threads = parse_size(optarg, "--threads",     UINT32_MAX); break;
+            case 'd': config.direct = true;  break;
+            case 'B': config.direct = false; break;
+            case 'r':
+                if      (strcmp(optarg, "auto")   == 0) config.reflink = REFLINK_AUTO;
+                else if (strcmp(optarg, "always") == 0) config.reflink = REFLINK_ALWAYS;
+                else if (strcmp(optarg, "never")  == 0) config.reflink = REFLINK_NEVER;
+                else
+                {
+                    fprintf(stderr, "Invalid value '%s' for option --reflink\n", optarg);
+                    exit(EXIT_FAILURE);
+                }
+                break;
+            case 'w': config.window_size = parse_size(optarg, "--window", UINT64_MAX); break;
+            case 'c': config.cold   = true;  break;
+            case 's': config.sparse = true;  break;
+            case 'S': config.sparse = false; break;
+            case 'z': config.skip_zeros = true;  break;
+            case 'Z': config.skip_zeros = false; break;
+            case 'u': config.uring_features = parse_uring_features(optarg); break;
+            case 'i': config.sq_idle_ms = parse_ms(optarg, "--sq-idle");   break;
+            case 'a': config.sq_cpu     = parse_cpu(optarg, "--sq-cpu");   break;
+            case 'n': config.num_buffers = parse_size(optarg, "--buffers", UINT32_MAX); break;
+            case 'R': config.num_rings   = parse_size(optarg, "--rings",   UINT32_MAX); break;
+            case 'h':
+                print_usage();
+                exit(EXIT_SUCCESS);
+            default:
+                print_usage();
+                exit(EXIT_FAILURE);
+        }
+    }
+
+    if (argc - optind != 2)
+    {
+        print_usage();
+        exit(EXIT_FAILURE);
+    }
+
+    // O_DIRECT requires sector-aligned buffers, offsets and sizes:
+    if (config.direct && config.block_size % 512U != 0U)
+    {
+        fprintf(stderr, "Block size (%u) must be a multiple of 512 for direct I/O\n", config.block_size);
+        exit(EXIT_FAILURE);
+    }
+
+    copy_file(engine, &config, argv[optind], argv[optind + 1]);
+
+    return EXIT_SUCCESS;
+}
@@ -0,0 +1,1043 @@
+// No copyright. 2024, Vladislav Aleinik
+#ifndef MSUSEM_IO_URING_ENGINE
+#define MSUSEM_IO_URING_ENGINE
+
+#include "copy-engine.h"
+
+#include <liburing.h>
+
+// Thread list of the process:
+#include <dirent.h>
+
+// Memory for the buffer ring:
+#include <sys/mman.h>
+// Threads of sharded copy:
+#include <pthread.h>
+#include <sched.h>
+
+// Tags of user_data for CQEs of linked reads (posted only on failure) and linked writes:
+#define IO_URING_LINKED_READ  (1ULL << 32U)
+#define IO_URING_LINKED_WRITE (1ULL << 33U)
+#define IO_URING_LINK_TAGS    (IO_URING_LINKED_READ|IO_URING_LINKED_WRITE)
+
+// Slots of the ring file table:
+#define IO_URING_SRC_SLOT 0U
+#define IO_URING_DST_SLOT 1U
+
+// Group of provided buffers:
+#define IO_URING_BUF_GROUP 0U
+// Limit on the number of provided buffers in a ring:
+#define IO_URING_MAX_BUFFERS 32768U
+
+//================
+// Copying status
+//================
+
+struct CopyStatus
+{
+    const struct CopyConfig* config;
+    struct CopyJob* job;
+
+    uint32_t num_block_in_progress;
+
+    struct BlockStatus* block_statuses;
+
+    uint8_t* aligned_buffers;
+    struct iovec* fixed_buffers;
+    uint32_t num_buffers;
+
+    // Index of the fixed buffer holding the block of each cell:
+    uint32_t* cell_buffers;
+    // Failure CQEs received for the broken linked pair of each cell:
+    uint8_t* link_failures;
+
+    // Provided buffers (buf-ring feature):
+    struct io_uring_buf_ring* buf_ring;
+    uint32_t num_free_buffers;
+    // Cells with blocks waiting for a free buffer:
+    uint32_t* waiting_cells;
+    uint32_t num_waiting_cells;
+
+    struct io_uring io_ring;
+
+    // Descriptors or file table slots used in requests:
+    int src_fd;
+    int dst_fd;
+    // IOSQE_FIXED_FILE for registered files:
+    uint8_t sqe_flags;
+
+    // Completions reaped at once (batch feature):
+    struct io_uring_cqe** cqe_batch;
+    uint32_t cqe_batch_size;
+
+    // Number of io_uring_enter() system calls:
+    uint64_t num_enters;
+    // Number of completions and of passes reaping them:
+    uint64_t num_cqes;
+    uint64_t num_reaps;
+};
+
+// NOTE: ring with wq_fd other than -1 shares kernel workers with the ring behind wq_fd.
+void init_copying_status(struct CopyStatus* status, const struct CopyConfig* config, struct CopyJob* job,
+                         int wq_fd)
+{
+    uint32_t queue_depth = config->queue_depth;
+
+    status->config = config;
+    status->job    = job;
+
+    status->num_block_in_progress = 0U;
+    status->num_enters            = 0U;
+    status->num_cqes              = 0U;
+    status->num_reaps             = 0U;
+
+    status->src_fd    = job->src_fd;
+    status->dst_fd    = job->dst_fd;
+    status->sqe_flags = 0U;
+
+    status->block_statuses = copy_alloc_block_statuses(queue_depth);
+
+    // Linked writes are prepared before the kernel picks the buffer for the read:
+    if ((config->uring_features & URING_LINK) && (config->uring_features & URING_BUF_RING))
+    {
+        fprintf(stderr, "Linked requests cannot use provided buffers\n");
+        exit(EXIT_FAILURE);
+    }
+
+    // Deferred completion work is run by the submitting task, not by the polling thread:
+    if ((config->uring_features & URING_SQPOLL) && (config->uring_features & URING_DEFER_TASKRUN))
+    {
+        fprintf(stderr, "SQ polling cannot be used with deferred task running\n");
+        exit(EXIT_FAILURE);
+    }
+
+    // Linked pairs take two SQEs per cell:
+    uint32_t ring_size = (config->uring_features & URING_LINK)? 2U * queue_depth : queue_depth;
+
+    // NOTE: there are at most two completions per cell in flight.
+    status->cqe_batch_size = 2U * queue_depth;
+    status->cqe_batch      = calloc(status->cqe_batch_size, sizeof(struct io_uring_cqe*));
+    if (status->cqe_batch == NULL)
+    {
+        fprintf(stderr, "Unable to allocate completion batch\n");
+        exit(EXIT_FAILURE);
+    }
+
+    struct io_uring_params params;
+    memset(&params, 0, sizeof(params));
+
+    // Completions are posted in io_uring_enter() of the copying thread, without interrupting it:
+    if (config->uring_features & URING_DEFER_TASKRUN)
+    {
+        params.flags |= IORING_SETUP_SINGLE_ISSUER|IORING_SETUP_DEFER_TASKRUN|IORING_SETUP_COOP_TASKRUN;
+    }
+
+    // Blocking requests of all rings are served by one pool of kernel workers:
+    if (wq_fd != -1)
+    {
+        params.flags |= IORING_SETUP_ATTACH_WQ;
+        params.wq_fd = wq_fd;
+    }
+
+    // Let the kernel thread pick up requests, so that submission needs no system calls:
+    if (config->uring_features & URING_SQPOLL)
+    {
+        params.flags |= IORING_SETUP_SQPOLL;
+        params.sq_thread_idle = config->sq_idle_ms;
+
+        if (config->sq_cpu >= 0)
+        {
+            params.flags |= IORING_SETUP_SQ_AFF;
+            params.sq_thread_cpu = config->sq_cpu;
+        }
+    }
+
+    // Initialize IO-userspace-ring:
+    int init_ret = io_uring_queue_init_params(ring_size, &status->io_ring, &params);
+    if (init_ret != 0)
+    {
+        fprintf(stderr, "Unable to initialize IO-ring: errno=%i (%s)\n", -init_ret, strerror(-init_ret));
+        exit(EXIT_FAILURE);
+    }
+
+    // Each cell has its own buffer, unless buffers are provided to the kernel:
+    status->num_buffers = queue_depth;
+    if (config->uring_features & URING_BUF_RING)
+    {
+        uint32_t num_buffers = (config->num_buffers == 0U)? queue_depth : config->num_buffers;
+
+        // NOTE: size of a buffer ring must be a power of two.
+        status->num_buffers = 1U;
+        while (status->num_buffers < num_buffers && status->num_buffers < IO_URING_MAX_BUFFERS)
+        {
+            status->num_buffers *= 2U;
+        }
+    }
+
+    // Create buffers to store intermediate data:
+    status->aligned_buffers = copy_alloc_buffers(config, status->num_buffers);
+
+    status->fixed_buffers = calloc(status->num_buffers, sizeof(struct iovec));
+    status->cell_buffers  = calloc(queue_depth, sizeof(uint32_t));
+    status->waiting_cells = calloc(queue_depth, sizeof(uint32_t));
+    status->link_failures = calloc(queue_depth, sizeof(uint8_t));
+    if (status->fixed_buffers == NULL || status->cell_buffers == NULL || status->waiting_cells == NULL ||
+        status->link_failures == NULL)
+    {
+        fprintf(stderr, "Unable to allocate fixed buffers\n");
+        exit(EXIT_FAILURE);
+    }
+
+    for (uint32_t i = 0U; i < status->num_buffers; ++i)
+    {
+        status->fixed_buffers[i].iov_base = status->aligned_buffers + i * config->block_size;
+        status->fixed_buffers[i].iov_len  = config->block_size;
+    }
+
+    for (uint32_t cell = 0U; cell < queue_depth; ++cell)
+    {
+        status->cell_buffers[cell] = cell;
+    }
+
+    // NOTE: provided buffers are registered too, so that writes from them stay fixed.
+    int register_ret = io_uring_register_buffers(&status->io_ring, status->fixed_buffers, status->num_buffers);
+    if (register_ret != 0)
+    {
+        fprintf(stderr, "Unable to register intermediate buffers: errno=%i (%s)\n",
+            -register_ret, strerror(-register_ret));
+        exit(EXIT_FAILURE);
+    }
+}
+
+void free_copying_status(struct CopyStatus* status)
+{
+    io_uring_queue_exit(&status->io_ring);
+
+    if (status->buf_ring != NULL)
+    {
+        munmap(status->buf_ring, status->num_buffers * sizeof(struct io_uring_buf));
+    }
+
+    free(status->block_statuses);
+    free(status->aligned_buffers);
+    free(status->fixed_buffers);
+    free(status->cell_buffers);
+    free(status->waiting_cells);
+    free(status->link_failures);
+    free(status->cqe_batch);
+}
+
+//==================
+// Provided buffers
+//==================
+
+// Give all buffers to the kernel, which picks one for each read at issue time:
+void provide_buffers(struct CopyStatus* status)
+{
+    status->buf_ring          = NULL;
+    status->num_free_buffers  = status->num_buffers;
+    status->num_waiting_cells = 0U;
+
+    if (!(status->config->uring_features & URING_BUF_RING))
+    {
+        return;
+    }
+
+    // Ring of buffer descriptors is shared with the kernel and must be page-aligned:
+    size_t ring_size = status->num_buffers * sizeof(struct io_uring_buf);
+    status->buf_ring = mmap(NULL, ring_size, PROT_READ|PROT_WRITE, MAP_ANONYMOUS|MAP_PRIVATE, -1, 0);
+    if (status->buf_ring == MAP_FAILED)
+    {
+        fprintf(stderr, "Unable to allocate buffer ring: errno=%i (%s)\n", errno, strerror(errno));
+        exit(EXIT_FAILURE);
+    }
+
+    struct io_uring_buf_reg reg = {
+        .ring_addr    = (uint64_t) (uintptr_t) status->buf_ring,
+        .ring_entries = status->num_buffers,
+        .bgid         = IO_URING_BUF_GROUP
+    };
+
+    int register_ret = io_uring_register_buf_ring(&status->io_ring, &reg, 0U);
+    if (register_ret != 0)
+    {
+        fprintf(stderr, "Unable to register buffer ring: errno=%i (%s)\n",
+            -register_ret, strerror(-register_ret));
+        exit(EXIT_FAILURE);
+    }
+
+    io_uring_buf_ring_init(status->buf_ring);
+
+    int mask = io_uring_buf_ring_mask(status->num_buffers);
+    for (uint32_t i = 0U; i < status->num_buffers; ++i)
+    {
+        io_uring_buf_ring_add(status->buf_ring, status->fixed_buffers[i].iov_base,
+                              status->config->block_size, i, mask, i);
+    }
+
+    io_uring_buf_ring_advance(status->buf_ring, status->num_buffers);
+}
+
+// Remember the buffer picked by the kernel for the read:
+void take_read_buffer(struct CopyStatus* status, unsigned cell, const struct io_uring_cqe* cqe)
+{
+    if (status->buf_ring == NULL)
+    {
+        return;
+    }
+
+    if (!(cqe->flags & IORING_CQE_F_BUFFER))
+    {
+        fprintf(stderr, "Read operation completed without buffer\n");
+        exit(EXIT_FAILURE);
+    }
+
+    status->cell_buffers[cell] = cqe->flags >> IORING_CQE_BUFFER_SHIFT;
+}
+
+void enqueue_read_request(struct CopyStatus* status, unsigned cell);
+
+// Return the buffer of the cell to the kernel and start a read waiting for it:
+void recycle_buffer(struct CopyStatus* status, unsigned cell)
+{
+    if (status->buf_ring == NULL)
+    {
+        return;
+    }
+
+    uint32_t buffer = status->cell_buffers[cell];
+
+    io_uring_buf_ring_add(status->buf_ring, status->fixed_buffers[buffer].iov_base,
+                          status->config->block_size, buffer,
+                          io_uring_buf_ring_mask(status->num_buffers), 0);
+    io_uring_buf_ring_advance(status->buf_ring, 1);
+
+    status->num_free_buffers += 1U;
+
+    if (status->num_waiting_cells != 0U)
+    {
+        status->num_waiting_cells -= 1U;
+        enqueue_read_request(status, status->waiting_cells[status->num_waiting_cells]);
+    }
+}
+
+//=====================
+// Basic IO operations
+//=====================
+
+struct io_uring_sqe* get_request_sqe(struct CopyStatus* status)
+{
+    struct io_uring_sqe* sqe;
+    while ((sqe = io_uring_get_sqe(&status->io_ring)) == NULL)
+    {
+        // Polling thread frees SQ entries in batches, so the queue may still be full:
+        if (status->config->uring_features & URING_SQPOLL)
+        {
+            io_uring_sqring_wait(&status->io_ring);
+        }
+        else
+        {
+            io_uring_submit(&status->io_ring);
+        }
+
+        status->num_enters += 1U;
+    }
+
+    return sqe;
+}
+
+void enqueue_read_request(struct CopyStatus* status, unsigned cell)
+{
+    struct BlockStatus* block = &status->block_statuses[cell];
+
+    block->stage = BLOCK_IN_READ;
+
+    if (status->buf_ring != NULL)
+    {
+        // Read without a free buffer would fail with ENOBUFS, so it waits for one in userspace:
+        if (status->num_free_buffers == 0U)
+        {
+            status->waiting_cells[status->num_waiting_cells] = cell;
+            status->num_waiting_cells += 1U;
+            return;
+        }
+
+        status->num_free_buffers -= 1U;
+
+        // Let the kernel pick the buffer:
+        struct io_uring_sqe* read_sqe = get_request_sqe(status);
+
+        io_uring_prep_read(read_sqe, status->src_fd, NULL,
+                           status->config->block_size, block->offset);
+
+        io_uring_sqe_set_flags(read_sqe, status->sqe_flags|IOSQE_BUFFER_SELECT);
+        read_sqe->buf_group = IO_URING_BUF_GROUP;
+        read_sqe->user_data = cell;
+        return;
+    }
+
+    // Enqueue read request:
+    struct io_uring_sqe* read_sqe = get_request_sqe(status);
+
+    io_uring_prep_read_fixed(read_sqe, status->src_fd,
+                             status->fixed_buffers[cell].iov_base,
+                             status->config->block_size, block->offset, cell);
+
+    io_uring_sqe_set_flags(read_sqe, status->sqe_flags);
+    read_sqe->user_data = cell;
+
+    // printf("Cell#%02d:  read (off=%lu, size=%u)\n", cell, block->offset, block->size);
+}
+
+struct io_uring_sqe* prepare_write_request(struct CopyStatus* status, unsigned cell)
+{
+    struct BlockStatus* block = &status->block_statuses[cell];
+
+    block->stage = BLOCK_IN_WRITE;
+
+    // Enqueue write request:
+    struct io_uring_sqe* write_sqe = get_request_sqe(status);
+
+    uint32_t buffer = status->cell_buffers[cell];
+    io_uring_prep_write_fixed(write_sqe, status->dst_fd,
+                              status->fixed_buffers[buffer].iov_base,
+                              block->size, block->offset, buffer);
+
+    io_uring_sqe_set_flags(write_sqe, status->sqe_flags);
+
+    // Update transfer status:
+    write_sqe->user_data = cell;
+
+    // printf("Cell#%02d: write (off=%lu, size=%u)\n", cell, block->offset, block->size);
+
+    return write_sqe;
+}
+
+// Enqueue read and write of the block, so that the kernel starts the write right after the read:
+// NOTE: a failed or short read cancels the write, then both post CQEs (the write with -ECANCELED).
+void enqueue_linked_requests(struct CopyStatus* status, unsigned cell)
+{
+    struct BlockStatus* block = &status->block_statuses[cell];
+
+    struct io_uring_sqe* read_sqe = get_request_sqe(status);
+
+    io_uring_prep_read_fixed(read_sqe, status->src_fd,
+                             status->fixed_buffers[cell].iov_base,
+                             status->config->block_size, block->offset, cell);
+
+    // Successful read needs no completion, only the write is reaped:
+    io_uring_sqe_set_flags(read_sqe, status->sqe_flags|IOSQE_IO_LINK|IOSQE_CQE_SKIP_SUCCESS);
+    read_sqe->user_data = cell | IO_URING_LINKED_READ;
+
+    // Write is cancelled if the read is short, so its CQE must be told apart from the retried read:
+    struct io_uring_sqe* write_sqe = prepare_write_request(status, cell);
+    write_sqe->user_data = cell | IO_URING_LINKED_WRITE;
+}
+
+void prepare_read_request(struct CopyStatus* status, unsigned cell)
+{
+    struct BlockStatus* block = &status->block_statuses[cell];
+
+    // Get the block to transfer:
+    if (!copy_job_next_block(status->job, status->config->block_size, &block->offset, &block->size))
+    {
+        return;
+    }
+
+    // Update transfer status:
+    status->num_block_in_progress += 1U;
+
+    // Last block is read short, which would break the link, so it goes unlinked:
+    // NOTE: linked writes are queued before the data is read, so all-zero blocks are written too.
+    if ((status->config->uring_features & URING_LINK) && block->size == status->config->block_size)
+    {
+        enqueue_linked_requests(status, cell);
+    }
+    else
+    {
+        enqueue_read_request(status, cell);
+    }
+}
+
+void finish_write_request(struct CopyStatus* status, unsigned cell)
+{
+    struct BlockStatus* block = &status->block_statuses[cell];
+
+    block->stage = BLOCK_IDLE;
+
+    // Update transfer status:
+    status->num_block_in_progress -= 1U;
+
+    recycle_buffer(status, cell);
+
+    // printf("Cell#%02d is IDLE\n", cell);
+}
+
+// Submit all queued requests and wait for at least one completion:
+void submit_and_wait_requests(struct CopyStatus* status)
+{
+    struct io_uring* ring = &status->io_ring;
+
+    if (!(status->config->uring_features & URING_SQPOLL))
+    {
+        io_uring_submit_and_wait(ring, 1U);
+        status->num_enters += 1U;
+        return;
+    }
+
+    // Polling thread takes requests by itself, the kernel is entered only to wake it up:
+    // NOTE: the thread may fall asleep right after the check, so the count is a lower bound.
+    uint32_t sq_flags = __atomic_load_n(ring->sq.kflags, __ATOMIC_ACQUIRE);
+    if (io_uring_sq_ready(ring) != 0U && (sq_flags & IORING_SQ_NEED_WAKEUP))
+    {
+        status->num_enters += 1U;
+    }
+
+    io_uring_submit(ring);
+
+    // Sleep in the kernel only if there are no completions yet:
+    struct io_uring_cqe* cqe;
+    if (io_uring_peek_cqe(ring, &cqe) != 0)
+    {
+        int wait_ret = io_uring_wait_cqe(ring, &cqe);
+        if (wait_ret != 0)
+        {
+            fprintf(stderr, "Unable to wait for completion: errno=%i (%s)\n", -wait_ret, strerror(-wait_ret));
+            exit(EXIT_FAILURE);
+        }
+
+        status->num_enters += 1U;
+    }
+}
+
+//==================
+// Registered files
+//==================
+
+// Open the file into the slot of the ring file table:
+void open_direct_file(struct CopyStatus* status, const char* filename, int flags, unsigned slot)
+{
+    struct io_uring_sqe* open_sqe = get_request_sqe(status);
+    io_uring_prep_openat_direct(open_sqe, AT_FDCWD, filename, flags, 0, slot);
+
+    io_uring_submit_and_wait(&status->io_ring, 1U);
+    status->num_enters += 1U;
+
+    struct io_uring_cqe* open_cqe;
+    int wait_ret = io_uring_wait_cqe(&status->io_ring, &open_cqe);
+    int open_ret = (wait_ret != 0)? wait_ret : open_cqe->res;
+    if (open_ret < 0)
+    {
+        fprintf(stderr, "Unable to open '%s' as direct descriptor: errno=%i (%s)\n",
+            filename, -open_ret, strerror(-open_ret));
+        exit(EXIT_FAILURE);
+    }
+
+    io_uring_cqe_seen(&status->io_ring, open_cqe);
+}
+
+// Refer to files by ring slots, so that requests skip file table lookups and reference counting:
+void register_copy_files(struct CopyStatus* status)
+{
+    const struct CopyConfig* config = status->config;
+
+    if (config->uring_features & URING_DIRECT_FDS)
+    {
+        int register_ret = io_uring_register_files_sparse(&status->io_ring, 2U);
+        if (register_ret != 0)
+        {
+            fprintf(stderr, "Unable to register file table: errno=%i (%s)\n",
+                -register_ret, strerror(-register_ret));
+            exit(EXIT_FAILURE);
+        }
+
+        // NOTE: regular descriptors of the job are still used for size, truncation and sync.
+        open_direct_file(status, status->job->src_filename,
+                         config->direct? O_RDONLY|O_DIRECT : O_RDONLY, IO_URING_SRC_SLOT);
+        open_direct_file(status, status->job->dst_filename, O_WRONLY, IO_URING_DST_SLOT);
+    }
+    else if (config->uring_features & URING_FIXED_FILES)
+    {
+        int fds[2] = {
+            [IO_URING_SRC_SLOT] = status->job->src_fd,
+            [IO_URING_DST_SLOT] = status->job->dst_fd
+        };
+
+        int register_ret = io_uring_register_files(&status->io_ring, fds, 2U);
+        if (register_ret != 0)
+        {
+            fprintf(stderr, "Unable to register files: errno=%i (%s)\n",
+                -register_ret, strerror(-register_ret));
+            exit(EXIT_FAILURE);
+        }
+    }
+    else
+    {
+        return;
+    }
+
+    status->src_fd    = IO_URING_SRC_SLOT;
+    status->dst_fd    = IO_URING_DST_SLOT;
+    status->sqe_flags = IOSQE_FIXED_FILE;
+}
+
+//==================
+// Kernel-side cost
+//==================
+
+// CPU time of the SQ polling thread, which is a thread of this process named "iou-sqp-<pid>":
+double io_uring_sqpoll_cpu_time_sec()
+{
+    DIR* tasks = opendir("/proc/self/task");
+    if (tasks == NULL)
+    {
+        return 0.0;
+    }
+
+    double cpu_sec = 0.0;
+
+    struct dirent* task;
+    while ((task = readdir(tasks)) != NULL)
+    {
+        char path[32U + sizeof(task->d_name)];
+        char comm[32] = "";
+
+        snprintf(path, sizeof(path), "/proc/self/task/%s/comm", task->d_name);
+        FILE* comm_file = fopen(path, "r");
+        if (comm_file == NULL)
+        {
+            continue;
+        }
+
+        bool is_poller = fgets(comm, sizeof(comm), comm_file) != NULL && strncmp(comm, "iou-sqp-", 8U) == 0;
+        fclose(comm_file);
+
+        if (!is_poller)
+        {
+            continue;
+        }
+
+        // Fields 14 and 15 of stat are user and system time in clock ticks:
+        snprintf(path, sizeof(path), "/proc/self/task/%s/stat", task->d_name);
+        FILE* stat_file = fopen(path, "r");
+        if (stat_file == NULL)
+        {
+            continue;
+        }
+
+        char stat[512] = "";
+        unsigned long utime, stime;
+
+        // NOTE: thread name may contain spaces, so parsing starts after its closing bracket.
+        char* fields = (fgets(stat, sizeof(stat), stat_file) != NULL)? strrchr(stat, ')') : NULL;
+        if (fields != NULL && sscanf(fields, ") %*c %*d %*d %*d %*d %*d %*u %*u %*u %*u %*u %lu %lu",
+                                     &utime, &stime) == 2)
+        {
+            cpu_sec += (double) (utime + stime) / sysconf(_SC_CLK_TCK);
+        }
+
+        fclose(stat_file);
+    }
+
+    closedir(tasks);
+    return cpu_sec;
+}
+
+void print_kernel_cost(struct CopyStatus* status)
+{
+    double gib = status->job->src_size / (1024.0 * 1024.0 * 1024.0);
+
+    printf("io_uring_enter calls: %lu (%.0f per GiB)", status->num_enters,
+        (gib == 0.0)? 0.0 : status->num_enters / gib);
+
+    // Polling thread time is a part of the total CPU time of the process:
+    if (status->config->uring_features & URING_SQPOLL)
+    {
+        printf(", SQ polling thread CPU %.3f sec", io_uring_sqpoll_cpu_time_sec());
+    }
+
+    printf("\n");
+
+    printf("Completions: %lu in %lu passes (%.1f per pass)\n", status->num_cqes, status->num_reaps,
+        (status->num_reaps == 0U)? 0.0 : (double) status->num_cqes / status->num_reaps);
+
+    if (status->buf_ring != NULL)
+    {
+        printf("Provided buffer pool: %u buffers, %.1f MiB\n", status->num_buffers,
+            status->num_buffers * (double) status->config->block_size / (1024.0 * 1024.0));
+    }
+}
+
+//=====================
+// Completion handling
+//=====================
+
+void handle_completion(struct CopyStatus* status, const struct io_uring_cqe* done_req)
+{
+    const struct CopyConfig* config = status->config;
+
+    unsigned cell_i = done_req->user_data & ~IO_URING_LINK_TAGS;
+    struct BlockStatus* block = &status->block_statuses[cell_i];
+
+    status->num_cqes += 1U;
+
+    // Broken link posts CQEs of both the failed read and the cancelled write, in any order:
+    if ((done_req->user_data & IO_URING_LINKED_READ) ||
+        ((done_req->user_data & IO_URING_LINKED_WRITE) && done_req->res == -ECANCELED))
+    {
+        status->link_failures[cell_i] += 1U;
+
+        // Copy the block with separate requests only when the pair is done with the cell:
+        // NOTE: errors are reported by the unlinked read.
+        if (status->link_failures[cell_i] == 2U)
+        {
+            status->link_failures[cell_i] = 0U;
+            enqueue_read_request(status, cell_i);
+        }
+    }
+    else if (block->stage == BLOCK_IN_READ)
+    {
+        if (done_req->res < 0)
+        {
+            fprintf(stderr, "Read operation failed at offset: %lu\n", block->offset);
+            exit(EXIT_FAILURE);
+        }
+
+        if ((uint32_t) done_req->res < block->size)
+        {
+            fprintf(stderr, "Source file ended early at offset: %lu (read %i of %u bytes)\n",
+                block->offset, done_req->res, block->size);
+            exit(EXIT_FAILURE);
+        }
+
+        take_read_buffer(status, cell_i, done_req);
+
+        uint32_t buffer = status->cell_buffers[cell_i];
+        if (copy_skip_zero_block(config, status->job, status->fixed_buffers[buffer].iov_base,
+                                 block->offset, block->size))
+        {
+            // All-zero block needs no write, reuse the cell right away:
+            finish_write_request(status, cell_i);
+            prepare_read_request(status, cell_i);
+        }
+        else
+        {
+            prepare_write_request(status, cell_i);
+        }
+    }
+    else if (block->stage == BLOCK_IN_WRITE)
+    {
+        if (done_req->res < 0 || (uint32_t) done_req->res != block->size)
+        {
+            fprintf(stderr, "Write operation failed at offset: %lu\n", block->offset);
+            exit(EXIT_FAILURE);
+        }
+
+        finish_write_request(status, cell_i);
+        prepare_read_request(status, cell_i);
+    }
+}
+
+// Take completions one at a time:
+void reap_completions(struct CopyStatus* status)
+{
+    struct io_uring_cqe* done_req;
+    while (io_uring_peek_cqe(&status->io_ring, &done_req) == 0)
+    {
+        handle_completion(status, done_req);
+        io_uring_cqe_seen(&status->io_ring, done_req);
+    }
+
+    status->num_reaps += 1U;
+}
+
+// Take all posted completions at once and release them with a single CQ head update:
+// NOTE: new requests go to the SQ, so CQ entries may stay in use while they are handled.
+void reap_completion_batch(struct CopyStatus* status)
+{
+    unsigned num_cqes = io_uring_peek_batch_cqe(&status->io_ring, status->cqe_batch,
+                                                status->cqe_batch_size);
+
+    for (unsigned i = 0U; i < num_cqes; ++i)
+    {
+        handle_completion(status, status->cqe_batch[i]);
+    }
+
+    io_uring_cq_advance(&status->io_ring, num_cqes);
+
+    status->num_reaps += 1U;
+}
+
+//===================
+// Ring copying loop
+//===================
+
+// Copy all blocks of the job with the initialized ring:
+void io_uring_run(struct CopyStatus* status)
+{
+    // Use all idle cells for reads:
+    for (uint32_t cell_i = 0U; cell_i < status->config->queue_depth; ++cell_i)
+    {
+        prepare_read_request(status, cell_i);
+    }
+
+    while (status->num_block_in_progress != 0U)
+    {
+        // Submit all unsubmitted reqs:
+        // NOTE: the same system call runs deferred completion work.
+        submit_and_wait_requests(status);
+
+        if (status->config->uring_features & URING_BATCH)
+        {
+            reap_completion_batch(status);
+        }
+        else
+        {
+            reap_completions(status);
+        }
+    }
+}
+
+//=================================
+// Sharded copy with several rings
+//=================================
+
+// Ring and thread copying one range of the file:
+struct RingShard
+{
+    const struct CopyConfig* config;
+
+    struct CopyJob job;
+    struct CopyStatus status;
+
+    pthread_t tid;
+    int32_t hart;
+
+    // Kernel workers of the first ring are shared by all rings:
+    struct RingShard* first;
+    pthread_barrier_t* first_ready;
+};
+
+void* ring_shard_func(void* arg)
+{
+    struct RingShard* shard = (struct RingShard*) arg;
+    const struct CopyConfig* config = shard->config;
+
+    // NOTE: single issuer ring must be created by the thread submitting to it.
+    if (shard == shard->first)
+    {
+        init_copying_status(&shard->status, config, &shard->job, -1);
+        pthread_barrier_wait(shard->first_ready);
+    }
+    else
+    {
+        pthread_barrier_wait(shard->first_ready);
+        init_copying_status(&shard->status, config, &shard->job, shard->first->status.io_ring.ring_fd);
+    }
+
+    register_copy_files(&shard->status);
+    provide_buffers(&shard->status);
+
+    io_uring_run(&shard->status);
+
+    return NULL;
+}
+
+// First sibling of the hart in its physical core, the hart itself if unknown:
+int32_t hart_core_leader(int32_t hart)
+{
+    char path[64U];
+    snprintf(path, sizeof(path), "/sys/devices/system/cpu/cpu%d/topology/thread_siblings_list", hart);
+
+    FILE* siblings = fopen(path, "r");
+    if (siblings == NULL)
+    {
+        return hart;
+    }
+
+    int32_t leader = hart;
+    if (fscanf(siblings, "%d", &leader) != 1)
+    {
+        leader = hart;
+    }
+
+    fclose(siblings);
+    return leader;
+}
+
+// Spread rings over physical cores first, then over their SMT siblings:
+void ring_shard_harts(int32_t* harts, uint32_t num_rings)
+{
+    cpu_set_t allowed;
+    if (sched_getaffinity(0, sizeof(allowed), &allowed) == -1)
+    {
+        fprintf(stderr, "Unable to get CPU affinity: errno=%i (%s)\n", errno, strerror(errno));
+        exit(EXIT_FAILURE);
+    }
+
+    int32_t order[CPU_SETSIZE];
+    uint32_t num_harts = 0U;
+    for (int pass = 0; pass < 2; ++pass)
+    {
+        for (int32_t hart = 0; hart < CPU_SETSIZE; ++hart)
+        {
+            if (CPU_ISSET(hart, &allowed) && (hart_core_leader(hart) == hart) == (pass == 0))
+            {
+                order[num_harts++] = hart;
+            }
+        }
+    }
+
+    // NOTE: rings share harts if there are more rings than harts.
+    for (uint32_t i = 0U; i < num_rings; ++i)
+    {
+        harts[i] = order[i % num_harts];
+    }
+}
+
+void io_uring_sharded_copy(const struct CopyConfig* config, struct CopyJob* job)
+{
+    uint32_t num_rings = config->num_rings;
+
+    struct RingShard* shards = calloc(num_rings, sizeof(struct RingShard));
+    int32_t* harts = calloc(num_rings, sizeof(int32_t));
+    if (shards == NULL || harts == NULL)
+    {
+        fprintf(stderr, "Unable to allocate ring shards\n");
+        exit(EXIT_FAILURE);
+    }
+
+    ring_shard_harts(harts, num_rings);
+
+    // Split the rest of the job into block-aligned ranges:
+    uint64_t num_blocks = (job->end - job->offset + config->block_size - 1U) / config->block_size;
+    uint64_t range_size = (num_blocks + num_rings - 1U) / num_rings * config->block_size;
+
+    pthread_barrier_t first_ready;
+    pthread_barrier_init(&first_ready, NULL, num_rings);
+
+    for (uint32_t i = 0U; i < num_rings; ++i)
+    {
+        struct RingShard* shard = &shards[i];
+
+        uint64_t start = job->offset + i * range_size;
+        uint64_t end   = start + range_size;
+        start = (start < job->end)? start : job->end;
+        end   = (end   < job->end)? end   : job->end;
+
+        copy_job_init_range(&shard->job, job, start, end);
+
+        shard->config      = config;
+        shard->hart        = harts[i];
+        shard->first       = &shards[0];
+        shard->first_ready = &first_ready;
+    }
+
+    // Spawn ring threads:
+    for (uint32_t i = 0U; i < num_rings; ++i)
+    {
+        pthread_attr_t thread_attributes;
+        int ret = pthread_attr_init(&thread_attributes);
+        if (ret != 0)
+        {
+            fprintf(stderr, "Unable to call pthread_attr_init\n");
+            exit(EXIT_FAILURE);
+        }
+
+        // Assign hardware thread to the ring thread:
+        cpu_set_t assigned_harts;
+        CPU_ZERO(&assigned_harts);
+        CPU_SET(shards[i].hart, &assigned_harts);
+
+        ret = pthread_attr_setaffinity_np(&thread_attributes, sizeof(cpu_set_t), &assigned_harts);
+        if (ret != 0)
+        {
+            fprintf(stderr, "Unable to call pthread_attr_setaffinity_np\n");
+            exit(EXIT_FAILURE);
+        }
+
+        ret = pthread_create(&shards[i].tid, &thread_attributes, ring_shard_func, &shards[i]);
+        if (ret != 0)
+        {
+            fprintf(stderr, "Unable to create ring thread#%u: %s\n", i, strerror(ret));
+            exit(EXIT_FAILURE);
+        }
+
+        pthread_attr_destroy(&thread_attributes);
+    }
+
+    // Wait for all ranges to be copied:
+    for (uint32_t i = 0U; i < num_rings; ++i)
+    {
+        pthread_join(shards[i].tid, NULL);
+    }
+
+    pthread_barrier_destroy(&first_ready);
+
+    // Sum up statistics of all rings:
+    struct CopyStatus* total = &shards[0].status;
+    printf("Rings: %u on harts", num_rings);
+    for (uint32_t i = 0U; i < num_rings; ++i)
+    {
+        printf(" %d", shards[i].hart);
+
+        job->skipped += shards[i].job.skipped;
+        job->zeroed  += atomic_load(&shards[i].job.zeroed);
+
+        if (i != 0U)
+        {
+            total->num_enters += shards[i].status.num_enters;
+            total->num_cqes   += shards[i].status.num_cqes;
+            total->num_reaps  += shards[i].status.num_reaps;
+        }
+    }
+
+    printf("\n");
+
+    job->offset = job->end;
+
+    // NOTE: buffer pool of a single ring is reported.
+    print_kernel_cost(total);
+
+    // Deallocate resources:
+    for (uint32_t i = 0U; i < num_rings; ++i)
+    {
+        free_copying_status(&shards[i].status);
+    }
+
+    free(shards);
+    free(harts);
+}
+
+//====================
+// Copy with io_uring
+//====================
+
+void io_uring_copy(const struct CopyConfig* config, struct CopyJob* job)
+{
+    if (config->num_rings > 1U)
+    {
+        io_uring_sharded_copy(config, job);
+        return;
+    }
+
+    struct CopyStatus status;
+    init_copying_status(&status, config, job, -1);
+    register_copy_files(&status);
+    provide_buffers(&status);
+
+    io_uring_run(&status);
+
+    // NOTE: polling thread exits with the ring.
+    print_kernel_cost(&status);
+
+    // Deallocate resources:
+    free_copying_status(&status);
+}
+
+const struct CopyEngine IO_URING_ENGINE = {
+    .name = "io-uring",
+    .copy = io_uring_copy
+};
+
+#endif // MSUSEM_IO_URING_ENGINE
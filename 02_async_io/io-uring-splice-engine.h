@@ -0,0 +1,278 @@
+// No copyright. 2024, Vladislav Aleinik
+#ifndef MSUSEM_IO_URING_SPLICE_ENGINE
+#define MSUSEM_IO_URING_SPLICE_ENGINE
+
+#include "copy-engine.h"
+
+#include <liburing.h>
+
+//=======================
+// Per-cell splice pipes
+//=======================
+
+// NOTE: source pages are moved into the pipe by reference, only the pipe-to-file step copies data.
+// NOTE: with O_DIRECT the source is read into private pages instead of the page cache.
+
+// Pipe carrying the block of a single queue cell:
+struct SplicePipe
+{
+    int fds[2];
+
+    // Bytes spliced into the pipe and not yet spliced out of it:
+    uint32_t filled;
+    // Bytes of the block already in the destination:
+    uint32_t done;
+};
+
+struct SpliceStatus
+{
+    const struct CopyConfig* config;
+    struct CopyJob* job;
+
+    uint32_t num_block_in_progress;
+
+    // BLOCK_IN_READ: file-to-pipe splice, BLOCK_IN_WRITE: pipe-to-file splice.
+    struct BlockStatus* block_statuses;
+    struct SplicePipe* pipes;
+    uint32_t pipe_size;
+
+    struct io_uring io_ring;
+
+    // Number of io_uring_enter() system calls:
+    uint64_t num_enters;
+};
+
+void init_splice_status(struct SpliceStatus* status, const struct CopyConfig* config, struct CopyJob* job)
+{
+    uint32_t queue_depth = config->queue_depth;
+
+    status->config = config;
+    status->job    = job;
+
+    status->num_block_in_progress = 0U;
+    status->num_enters            = 0U;
+
+    status->block_statuses = copy_alloc_block_statuses(queue_depth);
+
+    status->pipes = calloc(queue_depth, sizeof(struct SplicePipe));
+    if (status->pipes == NULL)
+    {
+        fprintf(stderr, "Unable to allocate splice pipes\n");
+        exit(EXIT_FAILURE);
+    }
+
+    status->pipe_size = config->block_size;
+    for (uint32_t cell = 0U; cell < queue_depth; ++cell)
+    {
+        if (pipe(status->pipes[cell].fds) == -1)
+        {
+            fprintf(stderr, "Unable to create pipe: errno=%i (%s)\n", errno, strerror(errno));
+            exit(EXIT_FAILURE);
+        }
+
+        // Try to fit the whole block into the pipe:
+        int pipe_size = fcntl(status->pipes[cell].fds[1], F_SETPIPE_SZ, config->block_size);
+        if (pipe_size == -1)
+        {
+            pipe_size = fcntl(status->pipes[cell].fds[1], F_GETPIPE_SZ);
+        }
+
+        if (pipe_size == -1)
+        {
+            fprintf(stderr, "Unable to get pipe size: errno=%i (%s)\n", errno, strerror(errno));
+            exit(EXIT_FAILURE);
+        }
+
+        if ((uint32_t) pipe_size < status->pipe_size)
+        {
+            status->pipe_size = pipe_size;
+        }
+    }
+
+    // Initialize IO-userspace-ring:
+    // NOTE: every cell has at most one request in flight.
+    int init_ret = io_uring_queue_init(queue_depth, &status->io_ring, 0U);
+    if (init_ret != 0)
+    {
+        fprintf(stderr, "Unable to initialize IO-ring: errno=%i (%s)\n", -init_ret, strerror(-init_ret));
+        exit(EXIT_FAILURE);
+    }
+}
+
+void free_splice_status(struct SpliceStatus* status)
+{
+    io_uring_queue_exit(&status->io_ring);
+
+    for (uint32_t cell = 0U; cell < status->config->queue_depth; ++cell)
+    {
+        close(status->pipes[cell].fds[0]);
+        close(status->pipes[cell].fds[1]);
+    }
+
+    free(status->block_statuses);
+    free(status->pipes);
+}
+
+//======================
+// Splice IO operations
+//======================
+
+struct io_uring_sqe* get_splice_sqe(struct SpliceStatus* status)
+{
+    struct io_uring_sqe* sqe = io_uring_get_sqe(&status->io_ring);
+    if (sqe == NULL)
+    {
+        fprintf(stderr, "Unable to get submission queue entry\n");
+        exit(EXIT_FAILURE);
+    }
+
+    return sqe;
+}
+
+// Move the next part of the block from the source into the pipe:
+void enqueue_splice_in(struct SpliceStatus* status, unsigned cell)
+{
+    struct BlockStatus* block = &status->block_statuses[cell];
+    struct SplicePipe* cell_pipe = &status->pipes[cell];
+
+    block->stage = BLOCK_IN_READ;
+
+    // NOTE: O_DIRECT needs the whole block_size, so only the tail of the file is asked for a full block.
+    // NOTE: other short blocks (cloned tails, extent ends) must not take bytes past their end.
+    bool at_eof = block->offset + block->size == status->job->src_size;
+    uint32_t size = (at_eof? status->config->block_size : block->size) - cell_pipe->done;
+    if (size > status->pipe_size)
+    {
+        size = status->pipe_size;
+    }
+
+    struct io_uring_sqe* sqe = get_splice_sqe(status);
+    io_uring_prep_splice(sqe, status->job->src_fd, block->offset + cell_pipe->done,
+                         cell_pipe->fds[1], -1, size, SPLICE_F_MOVE);
+    sqe->user_data = cell;
+}
+
+// Move bytes in the pipe into the destination:
+void enqueue_splice_out(struct SpliceStatus* status, unsigned cell)
+{
+    struct BlockStatus* block = &status->block_statuses[cell];
+    struct SplicePipe* cell_pipe = &status->pipes[cell];
+
+    block->stage = BLOCK_IN_WRITE;
+
+    struct io_uring_sqe* sqe = get_splice_sqe(status);
+    io_uring_prep_splice(sqe, cell_pipe->fds[0], -1, status->job->dst_fd,
+                         block->offset + cell_pipe->done, cell_pipe->filled, SPLICE_F_MOVE);
+    sqe->user_data = cell;
+}
+
+void prepare_splice_request(struct SpliceStatus* status, unsigned cell)
+{
+    struct BlockStatus* block = &status->block_statuses[cell];
+
+    if (!copy_job_next_block(status->job, status->config->block_size, &block->offset, &block->size))
+    {
+        block->stage = BLOCK_IDLE;
+        return;
+    }
+
+    status->pipes[cell].filled = 0U;
+    status->pipes[cell].done   = 0U;
+
+    status->num_block_in_progress += 1U;
+
+    enqueue_splice_in(status, cell);
+}
+
+void handle_splice_completion(struct SpliceStatus* status, const struct io_uring_cqe* cqe)
+{
+    unsigned cell = cqe->user_data;
+    struct BlockStatus* block = &status->block_statuses[cell];
+    struct SplicePipe* cell_pipe = &status->pipes[cell];
+
+    if (block->stage == BLOCK_IN_READ)
+    {
+        // NOTE: zero bytes mean the source is shorter than expected.
+        if (cqe->res <= 0)
+        {
+            fprintf(stderr, "Splice from source failed at offset: %lu\n", block->offset + cell_pipe->done);
+            exit(EXIT_FAILURE);
+        }
+
+        cell_pipe->filled = cqe->res;
+        enqueue_splice_out(status, cell);
+    }
+    else if (block->stage == BLOCK_IN_WRITE)
+    {
+        if (cqe->res <= 0)
+        {
+            fprintf(stderr, "Splice to destination failed at offset: %lu\n", block->offset + cell_pipe->done);
+            exit(EXIT_FAILURE);
+        }
+
+        cell_pipe->filled -= cqe->res;
+        cell_pipe->done   += cqe->res;
+
+        if (cell_pipe->filled != 0U)
+        {
+            // Drain the pipe before filling it again:
+            enqueue_splice_out(status, cell);
+        }
+        else if (cell_pipe->done != block->size)
+        {
+            // Block is larger than the pipe:
+            enqueue_splice_in(status, cell);
+        }
+        else
+        {
+            block->stage = BLOCK_IDLE;
+            status->num_block_in_progress -= 1U;
+
+            prepare_splice_request(status, cell);
+        }
+    }
+}
+
+//===========================
+// Copy with io_uring splice
+//===========================
+
+void io_uring_splice_copy(const struct CopyConfig* config, struct CopyJob* job)
+{
+    struct SpliceStatus status;
+    init_splice_status(&status, config, job);
+
+    // Use all idle cells:
+    for (uint32_t cell = 0U; cell < config->queue_depth; ++cell)
+    {
+        prepare_splice_request(&status, cell);
+    }
+
+    while (status.num_block_in_progress != 0U)
+    {
+        // Submit all unsubmitted reqs:
+        io_uring_submit_and_wait(&status.io_ring, 1U);
+        status.num_enters += 1U;
+
+        struct io_uring_cqe* cqe;
+        while (io_uring_peek_cqe(&status.io_ring, &cqe) == 0)
+        {
+            handle_splice_completion(&status, cqe);
+            io_uring_cqe_seen(&status.io_ring, cqe);
+        }
+    }
+
+    double gib = job->src_size / (1024.0 * 1024.0 * 1024.0);
+    printf("io_uring_enter calls: %lu (%.0f per GiB), pipe size %u bytes\n", status.num_enters,
+        (gib == 0.0)? 0.0 : status.num_enters / gib, status.pipe_size);
+
+    // Deallocate resources:
+    free_splice_status(&status);
+}
+
+const struct CopyEngine IO_URING_SPLICE_ENGINE = {
+    .name = "io-uring-splice",
+    .copy = io_uring_splice_copy
+};
+
+#endif // MSUSEM_IO_URING_SPLICE_ENGINE
@@ -0,0 +1,214 @@
+// No copyright. 2024, Vladislav Aleinik
+#ifndef MSUSEM_LINUX_AIO_ENGINE
+#define MSUSEM_LINUX_AIO_ENGINE
+
+#include "copy-engine.h"
+
+#include <libaio.h>
+
+//======================
+// Basic AIO operations
+//======================
+
+void io_read_setup(struct iocb* aio, int fd, off_t offset, void *buf, size_t size)
+{
+    // Remove info from previous request:
+    memset(aio, 0, sizeof(struct iocb));
+
+    aio->aio_fildes     = fd;           // File descriptor for the file to read from.
+    aio->aio_lio_opcode = IO_CMD_PREAD; // Command
+    aio->aio_reqprio    = 0;            // Request priority
+    aio->u.c.buf        = buf;          // Buffer to read the data into.
+    aio->u.c.nbytes     = size;         // Number of bytes to read.
+    aio->u.c.offset     = offset;       // Offset in the file to start reading from.
+}
+
+void io_write_setup(struct iocb* aio, int fd, off_t offset, void *buf, size_t size)
+{
+    // Remove info from previous request:
+    memset(aio, 0, sizeof(struct iocb));
+
+    aio->aio_fildes     = fd;            // File descriptor for the file to read from.
+    aio->aio_lio_opcode = IO_CMD_PWRITE; // Command
+    aio->aio_reqprio    = 0;             // Request priority
+    aio->u.c.buf        = buf;           // Buffer to read the data into.
+    aio->u.c.nbytes     = size;          // Number of bytes to read.
+    aio->u.c.offset     = offset;        // Offset in the file to start reading from.
+}
+
+//=====================
+// Copy with Linux AIO
+//=====================
+
+// Prepare read of the next block into the cell, return false if there are no blocks left:
+bool linux_aio_read_next(const struct CopyConfig* config, struct CopyJob* job,
+                         struct iocb* iocb, struct BlockStatus* block, uint8_t* buffer, size_t cell)
+{
+    if (!copy_job_next_block(job, config->block_size, &block->offset, &block->size))
+    {
+        block->stage = BLOCK_IDLE;
+        return false;
+    }
+
+    block->stage = BLOCK_IN_READ;
+    io_read_setup(iocb, job->src_fd, block->offset, buffer, config->block_size);
+
+    // Remember the cell of the request:
+    iocb->data = (void*) cell;
+
+    return true;
+}
+
+void linux_aio_copy(const struct CopyConfig* config, struct CopyJob* job)
+{
+    uint32_t queue_depth = config->queue_depth;
+
+    uint8_t* buffers = copy_alloc_buffers(config, queue_depth);
+
+    //==============================
+    // Prepare AIO meta-information
+    //==============================
+
+    // AIO context:
+    io_context_t io_ctx;
+    memset(&io_ctx, 0, sizeof(io_ctx));
+
+    int setup_ret = io_setup(queue_depth, &io_ctx);
+    if (setup_ret != 0)
+    {
+        fprintf(stderr, "Unable to setup AIO context: errno=%i (%s)\n",
+            -setup_ret, strerror(-setup_ret));
+        exit(EXIT_FAILURE);
+    }
+
+    // IO buffers:
+    struct iocb* iocbs = calloc(queue_depth, sizeof(struct iocb));
+
+    // IO events:
+    struct io_event* events = calloc(queue_depth, sizeof(struct io_event));
+
+    // Array of AIO requests to submit:
+    struct iocb** submit_list = calloc(queue_depth, sizeof(struct iocb*));
+
+    if (iocbs == NULL || events == NULL || submit_list == NULL)
+    {
+        fprintf(stderr, "Unable to allocate AIO control blocks\n");
+        exit(EXIT_FAILURE);
+    }
+
+    struct BlockStatus* blocks = copy_alloc_block_statuses(queue_depth);
+
+    //=====================
+    // Actual file copying
+    //=====================
+
+    // Start initial read requests:
+    size_t num_io_reqs = 0U;
+    for (size_t aio_i = 0U; aio_i < queue_depth; ++aio_i)
+    {
+        if (!linux_aio_read_next(config, job, &iocbs[aio_i], &blocks[aio_i],
+                                 &buffers[aio_i * config->block_size], aio_i))
+        {
+            break;
+        }
+
+        // Put I/O in submit list:
+        submit_list[aio_i] = &iocbs[aio_i];
+        num_io_reqs += 1U;
+    }
+
+    // Cycle while there are active I/Os
+    size_t num_to_submit = num_io_reqs;
+    while (num_io_reqs != 0U)
+    {
+        // Submit all I/Os:
+        if (num_to_submit != 0U)
+        {
+            int submit_ret = io_submit(io_ctx, num_to_submit, submit_list);
+            if (submit_ret < 0 || (size_t) submit_ret != num_to_submit)
+            {
+                fprintf(stderr, "Unable to submit I/Os\n");
+                exit(EXIT_FAILURE);
+            }
+        }
+
+        // Wait for at least one I/O:
+        int num_events = io_getevents(io_ctx, 1U, queue_depth, events, NULL);
+        if (num_events < 0 && num_events != -EINTR)
+        {
+            fprintf(stderr, "Unable to get finished I/O events\n");
+            exit(EXIT_FAILURE);
+        }
+
+        // Handle finished requests:
+        num_to_submit = 0U;
+        for (int ev = 0; ev < num_events; ++ev)
+        {
+            // Get current iocb:
+            struct iocb* iocb = events[ev].obj;
+            long io_ret       = (long) events[ev].res;
+
+            size_t cell = (size_t) iocb->data;
+            struct BlockStatus* block = &blocks[cell];
+
+            if (block->stage == BLOCK_IN_READ)
+            {
+                if (io_ret < block->size)
+                {
+                    fprintf(stderr, "Unable to read block [%lx, %lx)\n",
+                        block->offset, block->offset + block->size);
+                    exit(EXIT_FAILURE);
+                }
+
+                // Now write read data:
+                if (!copy_skip_zero_block(config, job, iocb->u.c.buf, block->offset, block->size))
+                {
+                    block->stage = BLOCK_IN_WRITE;
+                    io_write_setup(iocb, job->dst_fd, block->offset, iocb->u.c.buf, block->size);
+                    iocb->data = (void*) cell;
+
+                    // Register request into submit list:
+                    submit_list[num_to_submit] = iocb;
+                    num_to_submit++;
+                    continue;
+                }
+            }
+            else if (block->stage == BLOCK_IN_WRITE)
+            {
+                if (io_ret != block->size)
+                {
+                    fprintf(stderr, "Unable to write block [%lx, %lx)\n",
+                        block->offset, block->offset + block->size);
+                    exit(EXIT_FAILURE);
+                }
+            }
+
+            // Request another read operation (block is written or needs no write):
+            if (linux_aio_read_next(config, job, iocb, block, iocb->u.c.buf, cell))
+            {
+                // Register request into submit list:
+                submit_list[num_to_submit] = iocb;
+                num_to_submit++;
+            }
+            else
+            {
+                num_io_reqs -= 1U;
+            }
+        }
+    }
+
+    io_destroy(io_ctx);
+
+    free(blocks);
+    free(submit_list);
+    free(events);
+    free(iocbs);
+    free(buffers);
+}
+
+const struct CopyEngine LINUX_AIO_ENGINE = {
+    .name = "linux-aio",
+    .copy = linux_aio_copy
+};
+
+#endif // MSUSEM_LINUX_AIO_ENGINE
@@ -0,0 +1,158 @@
+// No copyright. 2024, Vladislav Aleinik
+#ifndef MSUSEM_MMAP_ENGINE
+#define MSUSEM_MMAP_ENGINE
+
+#include "copy-engine.h"
+
+// Memory mapping:
+#include <sys/mman.h>
+
+//=====================
+// Sliding file window
+//=====================
+
+// Default size of mapped file window:
+#define MMAP_DEFAULT_WINDOW_SIZE (64U * 1024U * 1024U)
+
+// Part of both files mapped at the same offset:
+struct MmapWindow
+{
+    uint64_t start;
+    uint64_t size;
+
+    // Pages before this offset are already released:
+    uint64_t released;
+
+    uint8_t* src;
+    uint8_t* dst;
+};
+
+void mmap_unmap_window(struct MmapWindow* window)
+{
+    if (window->size == 0U)
+    {
+        return;
+    }
+
+    if (munmap(window->src, window->size) == -1 || munmap(window->dst, window->size) == -1)
+    {
+        fprintf(stderr, "Unable to unmap file window: errno=%i (%s)\n", errno, strerror(errno));
+        exit(EXIT_FAILURE);
+    }
+
+    window->size = 0U;
+}
+
+void mmap_map_window(struct MmapWindow* window, struct CopyJob* job,
+                     uint64_t offset, uint64_t window_size)
+{
+    uint64_t page_size = sysconf(_SC_PAGESIZE);
+
+    // File offset of the mapping must be page-aligned:
+    window->start    = offset / page_size * page_size;
+    window->size     = job->src_size - window->start;
+    window->released = window->start;
+    if (window->size > window_size)
+    {
+        window->size = window_size;
+    }
+
+    window->src = mmap(NULL, window->size, PROT_READ, MAP_SHARED, job->src_fd, window->start);
+    if (window->src == MAP_FAILED)
+    {
+        fprintf(stderr, "Unable to map source window at %lx: errno=%i (%s)\n",
+            window->start, errno, strerror(errno));
+        exit(EXIT_FAILURE);
+    }
+
+    // Source is read once front to back, start reading it ahead of the copy:
+    if (madvise(window->src, window->size, MADV_SEQUENTIAL) == -1 ||
+        madvise(window->src, window->size, MADV_WILLNEED)   == -1)
+    {
+        fprintf(stderr, "Unable to advise source window: errno=%i (%s)\n", errno, strerror(errno));
+        exit(EXIT_FAILURE);
+    }
+
+    // NOTE: destination is already extended to src_size before copying.
+    window->dst = mmap(NULL, window->size, PROT_READ|PROT_WRITE, MAP_SHARED, job->dst_fd, window->start);
+    if (window->dst == MAP_FAILED)
+    {
+        fprintf(stderr, "Unable to map destination window at %lx: errno=%i (%s)\n",
+            window->start, errno, strerror(errno));
+        exit(EXIT_FAILURE);
+    }
+}
+
+// Release pages behind the cursor to bound RSS:
+// NOTE: page cache keeps the pages (and dirty data) after MADV_DONTNEED on a shared mapping.
+void mmap_release_behind(struct MmapWindow* window, uint64_t cursor)
+{
+    uint64_t page_size = sysconf(_SC_PAGESIZE);
+
+    uint64_t release_end = cursor / page_size * page_size;
+    if (release_end <= window->released)
+    {
+        return;
+    }
+
+    uint64_t window_off = window->released - window->start;
+    uint64_t length     = release_end - window->released;
+
+    if (madvise(window->src + window_off, length, MADV_DONTNEED) == -1 ||
+        madvise(window->dst + window_off, length, MADV_DONTNEED) == -1)
+    {
+        fprintf(stderr, "Unable to release copied pages: errno=%i (%s)\n", errno, strerror(errno));
+        exit(EXIT_FAILURE);
+    }
+
+    window->released = release_end;
+}
+
+//=====================
+// Copy through mmap()
+//=====================
+
+void mmap_copy(const struct CopyConfig* config, struct CopyJob* job)
+{
+    uint64_t page_size = sysconf(_SC_PAGESIZE);
+
+    // Window must fit at least one block and be page-aligned:
+    uint64_t window_size = (config->window_size == 0U)? MMAP_DEFAULT_WINDOW_SIZE : config->window_size;
+    if (window_size < config->block_size + page_size)
+    {
+        window_size = config->block_size + page_size;
+    }
+
+    window_size = (window_size + page_size - 1U) / page_size * page_size;
+
+    struct MmapWindow window = {.start = 0U, .size = 0U, .released = 0U, .src = NULL, .dst = NULL};
+
+    uint64_t offset;
+    uint32_t size;
+    while (copy_job_next_block(job, config->block_size, &offset, &size))
+    {
+        // Slide the window:
+        if (offset < window.start || window.start + window.size < offset + size)
+        {
+            mmap_unmap_window(&window);
+            mmap_map_window(&window, job, offset, window_size);
+        }
+
+        uint64_t window_off = offset - window.start;
+        if (!copy_skip_zero_block(config, job, window.src + window_off, offset, size))
+        {
+            vector_copy(window.dst + window_off, window.src + window_off, size);
+        }
+
+        mmap_release_behind(&window, offset + size);
+    }
+
+    mmap_unmap_window(&window);
+}
+
+const struct CopyEngine MMAP_ENGINE = {
+    .name = "mmap",
+    .copy = mmap_copy
+};
+
+#endif // MSUSEM_MMAP_ENGINE
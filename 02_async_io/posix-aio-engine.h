@@ -0,0 +1,190 @@
+// No copyright. 2024, Vladislav Aleinik
+#ifndef MSUSEM_POSIX_AIO_ENGINE
+#define MSUSEM_POSIX_AIO_ENGINE
+
+#include "copy-engine.h"
+
+#include <aio.h>
+
+//======================
+// Basic AIO operations
+//======================
+
+void aio_read_setup(struct aiocb* aio, int fd, off_t offset, volatile void *buf, size_t size)
+{
+    // Remove info from previous request:
+    memset(aio, 0, sizeof(struct aiocb));
+
+    aio->aio_fildes = fd;       // File descriptor for the file to read from.
+    aio->aio_buf    = buf;      // Buffer to read the data into.
+    aio->aio_nbytes = size;     // Number of bytes to read.
+    aio->aio_offset = offset;   // Offset in the file to start reading from.
+
+    // Initiate the read operation:
+    if (aio_read(aio) == -1)
+    {
+        perror("Unable to request read");
+        exit(EXIT_FAILURE);
+    }
+}
+
+void aio_write_setup(struct aiocb* aio, int fd, off_t offset, volatile void *buf, size_t size)
+{
+    // Remove info from previous request:
+    memset(aio, 0, sizeof(struct aiocb));
+
+    aio->aio_fildes = fd;       // File descriptor for the file to write to.
+    aio->aio_buf    = buf;      // Buffer to write the data from.
+    aio->aio_nbytes = size;     // Number of bytes to written.
+    aio->aio_offset = offset;   // Offset in the file to start writing from.
+
+    // Initiate the write operation:
+    if (aio_write(aio) == -1)
+    {
+        perror("Unable to request write");
+        exit(EXIT_FAILURE);
+    }
+}
+
+//=====================
+// Copy with POSIX AIO
+//=====================
+
+// Start reading the next block into the cell, return false if there are no blocks left:
+bool posix_aio_read_next(const struct CopyConfig* config, struct CopyJob* job,
+                         struct aiocb* aio, struct BlockStatus* block, uint8_t* buffer)
+{
+    if (!copy_job_next_block(job, config->block_size, &block->offset, &block->size))
+    {
+        block->stage = BLOCK_IDLE;
+        return false;
+    }
+
+    block->stage = BLOCK_IN_READ;
+    aio_read_setup(aio, job->src_fd, block->offset, buffer, config->block_size);
+
+    return true;
+}
+
+void posix_aio_copy(const struct CopyConfig* config, struct CopyJob* job)
+{
+    uint32_t queue_depth = config->queue_depth;
+
+    uint8_t* buffers = copy_alloc_buffers(config, queue_depth);
+
+    //==============================
+    // Prepare AIO meta-information
+    //==============================
+
+    // Array of AIO control blocks:
+    struct aiocb* aiocbs = calloc(queue_depth, sizeof(struct aiocb));
+    if (aiocbs == NULL)
+    {
+        fprintf(stderr, "Unable to allocate AIO control blocks\n");
+        exit(EXIT_FAILURE);
+    }
+
+    struct BlockStatus* blocks = copy_alloc_block_statuses(queue_depth);
+
+    // Array of ongoing AIO requests:
+    const struct aiocb** wait_list = calloc(queue_depth, sizeof(struct aiocb*));
+    if (wait_list == NULL)
+    {
+        fprintf(stderr, "Unable to allocate AIO wait list\n");
+        exit(EXIT_FAILURE);
+    }
+
+    //=====================
+    // Actual file copying
+    //=====================
+
+    // Start initial read requests:
+    size_t num_io_reqs = 0U;
+    for (size_t aio_i = 0U; aio_i < queue_depth; ++aio_i)
+    {
+        if (!posix_aio_read_next(config, job, &aiocbs[aio_i], &blocks[aio_i],
+                                 &buffers[aio_i * config->block_size]))
+        {
+            break;
+        }
+
+        // Put AIO in wait list:
+        wait_list[aio_i] = &aiocbs[aio_i];
+        num_io_reqs += 1U;
+    }
+
+    // Cycle while there are active I/Os
+    while (num_io_reqs != 0U)
+    {
+        int suspend_ret = aio_suspend(wait_list, queue_depth, NULL);
+        if (suspend_ret == -1 && errno != EINTR)
+        {
+            fprintf(stderr, "Unable to suspend-wait for AIOs\n");
+            exit(EXIT_FAILURE);
+        }
+
+        for (size_t aio_i = 0U; aio_i < queue_depth; ++aio_i)
+        {
+            // Skip if AIO is already done:
+            if (wait_list[aio_i] == NULL) continue;
+
+            // Skip if AIO is still in progress:
+            int error_ret = aio_error(&aiocbs[aio_i]);
+            if (error_ret == EINPROGRESS) continue;
+
+            struct BlockStatus* block = &blocks[aio_i];
+            ssize_t io_ret = aio_return(&aiocbs[aio_i]);
+
+            if (block->stage == BLOCK_IN_READ)
+            {
+                if (io_ret == -1 || io_ret < block->size)
+                {
+                    fprintf(stderr, "Unable to read block [%lx, %lx)\n",
+                        block->offset, block->offset + block->size);
+                    exit(EXIT_FAILURE);
+                }
+
+                // Now write read data:
+                if (!copy_skip_zero_block(config, job, &buffers[aio_i * config->block_size],
+                                          block->offset, block->size))
+                {
+                    block->stage = BLOCK_IN_WRITE;
+                    aio_write_setup(&aiocbs[aio_i], job->dst_fd, block->offset,
+                        &buffers[aio_i * config->block_size], block->size);
+                    continue;
+                }
+            }
+            else if (block->stage == BLOCK_IN_WRITE)
+            {
+                if (io_ret != block->size)
+                {
+                    fprintf(stderr, "Unable to write block [%lx, %lx)\n",
+                        block->offset, block->offset + block->size);
+                    exit(EXIT_FAILURE);
+                }
+            }
+
+            // Request another read operation (block is written or needs no write):
+            if (!posix_aio_read_next(config, job, &aiocbs[aio_i], block,
+                                     &buffers[aio_i * config->block_size]))
+            {
+                // Remove AIO from wait list:
+                wait_list[aio_i] = NULL;
+
+                num_io_reqs -= 1U;
+            }
+        }
+    }
+
+    free(wait_list);
+    free(blocks);
+    free(aiocbs);
+    free(buffers);
+}
+
+const struct CopyEngine POSIX_AIO_ENGINE = {
+    .name = "posix-aio",
+    .copy = posix_aio_copy
+};
+
+#endif // MSUSEM_POSIX_AIO_ENGINE
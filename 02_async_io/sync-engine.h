@@ -0,0 +1,54 @@
+// No copyright. 2024, Vladislav Aleinik
+#ifndef MSUSEM_SYNC_ENGINE
+#define MSUSEM_SYNC_ENGINE
+
+#include "copy-engine.h"
+
+//======================
+// Synchronous transfer
+//======================
+
+// Copy a single block with blocking system calls:
+void sync_copy_block(const struct CopyConfig* config, struct CopyJob* job, uint8_t* buffer,
+                     uint64_t offset, uint32_t size)
+{
+    ssize_t bytes_read = pread(job->src_fd, buffer, config->block_size, offset);
+    if (bytes_read == -1 || bytes_read < size)
+    {
+        fprintf(stderr, "Unable to read block [%lx, %lx)\n", offset, offset + size);
+        exit(EXIT_FAILURE);
+    }
+
+    if (copy_skip_zero_block(config, job, buffer, offset, size))
+    {
+        return;
+    }
+
+    ssize_t bytes_written = pwrite(job->dst_fd, buffer, size, offset);
+    if (bytes_written == -1 || bytes_written != size)
+    {
+        fprintf(stderr, "Unable to write block [%lx, %lx)\n", offset, offset + size);
+        exit(EXIT_FAILURE);
+    }
+}
+
+void sync_copy(const struct CopyConfig* config, struct CopyJob* job)
+{
+    uint8_t* buffer = copy_alloc_buffers(config, 1U);
+
+    uint64_t offset;
+    uint32_t size;
+    while (copy_job_next_block(job, config->block_size, &offset, &size))
+    {
+        sync_copy_block(config, job, buffer, offset, size);
+    }
+
+    free(buffer);
+}
+
+const struct CopyEngine SYNC_ENGINE = {
+    .name = "sync",
+    .copy = sync_copy
+};
+
+#endif // MSUSEM_SYNC_ENGINE
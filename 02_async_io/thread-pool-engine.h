@@ -0,0 +1,116 @@
+// No copyright. 2024, Vladislav Aleinik
+#ifndef MSUSEM_THREAD_POOL_ENGINE
+#define MSUSEM_THREAD_POOL_ENGINE
+
+#include "sync-engine.h"
+
+// Threads:
+#include <pthread.h>
+// Persistent worker pool:
+#include "../01_pthreads_sync/worker-pool.h"
+
+//============================
+// Thread function parameters
+//============================
+
+struct ThreadPoolShared
+{
+    const struct CopyConfig* config;
+    struct CopyJob* job;
+
+    // Protects block distribution among the workers:
+    pthread_mutex_t job_lock;
+};
+
+struct ThreadPoolArgs
+{
+    struct ThreadPoolShared* shared;
+    uint8_t* buffer;
+};
+
+void* thread_pool_copy_func(void* thread_args)
+{
+    struct ThreadPoolArgs* args = (struct ThreadPoolArgs*) thread_args;
+    struct ThreadPoolShared* shared = args->shared;
+
+    uint32_t block_size = shared->config->block_size;
+
+    while (true)
+    {
+        // Take the next block:
+        uint64_t offset;
+        uint32_t size;
+
+        pthread_mutex_lock(&shared->job_lock);
+        bool has_block = copy_job_next_block(shared->job, block_size, &offset, &size);
+        pthread_mutex_unlock(&shared->job_lock);
+
+        if (!has_block)
+        {
+            break;
+        }
+
+        sync_copy_block(shared->config, shared->job, args->buffer, offset, size);
+    }
+
+    return NULL;
+}
+
+//=========================
+// Copy with blocking pool
+//=========================
+
+void thread_pool_copy(const struct CopyConfig* config, struct CopyJob* job)
+{
+    uint32_t num_threads = config->num_threads;
+
+    uint8_t* buffers = copy_alloc_buffers(config, num_threads);
+
+    struct ThreadPoolShared shared = {
+        .config = config,
+        .job    = job
+    };
+    pthread_mutex_init(&shared.job_lock, NULL);
+
+    // Initialize thread data:
+    struct ThreadPoolArgs* args = calloc(num_threads, sizeof(struct ThreadPoolArgs));
+    if (args == NULL)
+    {
+        fprintf(stderr, "Unable to allocate thread arguments\n");
+        exit(EXIT_FAILURE);
+    }
+
+    for (size_t i = 0U; i < num_threads; ++i)
+    {
+        args[i].shared = &shared;
+        args[i].buffer = &buffers[i * config->block_size];
+    }
+
+    // Start persistent worker pool:
+    WORKER_POOL pool;
+    worker_pool_init(&pool, num_threads, sysconf(_SC_NPROCESSORS_ONLN));
+
+    // Submit work to pool workers:
+    for (size_t i = 0U; i < num_threads; ++i)
+    {
+        worker_pool_submit(&pool, i, thread_pool_copy_func, &args[i]);
+    }
+
+    // Wait for all workers to finish execution:
+    worker_pool_wait(&pool);
+
+    // Stop worker threads:
+    worker_pool_destroy(&pool);
+
+    pthread_mutex_destroy(&shared.job_lock);
+
+    free(args);
+    free(buffers);
+}
+
+const struct CopyEngine THREAD_POOL_ENGINE = {
+    .name = "thread-pool",
+    .copy = thread_pool_copy
+};
+
+#endif // MSUSEM_THREAD_POOL_ENGINE
@@ -0,0 +1,209 @@
+// No copyright. 2024, Vladislav Aleinik
+#ifndef MSUSEM_VECTOR_KERNELS
+#define MSUSEM_VECTOR_KERNELS
+
+#include <stdint.h>
+#include <stdbool.h>
+#include <string.h>
+
+// SIMD intrinsics:
+#if defined(__x86_64__)
+#include <immintrin.h>
+#endif
+
+//==========================
+// Non-temporal copy kernel
+//==========================
+
+// NOTE: streaming stores bypass CPU caches, so copied data does not evict the working set.
+
+#if defined(__x86_64__)
+
+__attribute__((target("avx2")))
+void vector_copy_avx2(uint8_t* dst, const uint8_t* src, size_t size)
+{
+    // Align destination for streaming stores:
+    size_t i = (-(uintptr_t) dst) & 31U;
+    if (i > size)
+    {
+        i = size;
+    }
+
+    memcpy(dst, src, i);
+
+    for (; i + 128U <= size; i += 128U)
+    {
+        __m256i v0 = _mm256_loadu_si256((const __m256i*) (src + i));
+        __m256i v1 = _mm256_loadu_si256((const __m256i*) (src + i + 32U));
+        __m256i v2 = _mm256_loadu_si256((const __m256i*) (src + i + 64U));
+        __m256i v3 = _mm256_loadu_si256((const __m256i*) (src + i + 96U));
+
+        _mm256_stream_si256((__m256i*) (dst + i),       v0);
+        _mm256_stream_si256((__m256i*) (dst + i + 32U), v1);
+        _mm256_stream_si256((__m256i*) (dst + i + 64U), v2);
+        _mm256_stream_si256((__m256i*) (dst + i + 96U), v3);
+    }
+
+    for (; i + 32U <= size; i += 32U)
+    {
+        __m256i v = _mm256_loadu_si256((const __m256i*) (src + i));
+        _mm256_stream_si256((__m256i*) (dst + i), v);
+    }
+
+    memcpy(dst + i, src + i, size - i);
+
+    // Order streaming stores before the following regular stores:
+    _mm_sfence();
+}
+
+void vector_copy_sse2(uint8_t* dst, const uint8_t* src, size_t size)
+{
+    // Align destination for streaming stores:
+    size_t i = (-(uintptr_t) dst) & 15U;
+    if (i > size)
+    {
+        i = size;
+    }
+
+    memcpy(dst, src, i);
+
+    for (; i + 64U <= size; i += 64U)
+    {
+        __m128i v0 = _mm_loadu_si128((const __m128i*) (src + i));
+        __m128i v1 = _mm_loadu_si128((const __m128i*) (src + i + 16U));
+        __m128i v2 = _mm_loadu_si128((const __m128i*) (src + i + 32U));
+        __m128i v3 = _mm_loadu_si128((const __m128i*) (src + i + 48U));
+
+        _mm_stream_si128((__m128i*) (dst + i),       v0);
+        _mm_stream_si128((__m128i*) (dst + i + 16U), v1);
+        _mm_stream_si128((__m128i*) (dst + i + 32U), v2);
+        _mm_stream_si128((__m128i*) (dst + i + 48U), v3);
+    }
+
+    memcpy(dst + i, src + i, size - i);
+
+    // Order streaming stores before the following regular stores:
+    _mm_sfence();
+}
+
+#endif // __x86_64__
+
+void vector_copy(uint8_t* dst, const uint8_t* src, size_t size)
+{
+#if defined(__x86_64__)
+    if (__builtin_cpu_supports("avx2"))
+    {
+        vector_copy_avx2(dst, src, size);
+    }
+    else
+    {
+        // SSE2 is a part of x86-64 baseline:
+        vector_copy_sse2(dst, src, size);
+    }
+#else
+    memcpy(dst, src, size);
+#endif
+}
+
+//======================
+// Zero block detection
+//======================
+
+bool vector_is_zero_scalar(const uint8_t* data, size_t size)
+{
+    size_t i = 0U;
+    for (; i + 8U <= size; i += 8U)
+    {
+        uint64_t word;
+        memcpy(&word, data + i, sizeof(word));
+
+        if (word != 0U)
+        {
+            return false;
+        }
+    }
+
+    for (; i < size; ++i)
+    {
+        if (data[i] != 0U)
+        {
+            return false;
+        }
+    }
+
+    return true;
+}
+
+#if defined(__x86_64__)
+
+__attribute__((target("avx2")))
+bool vector_is_zero_avx2(const uint8_t* data, size_t size)
+{
+    size_t i = 0U;
+    for (; i + 128U <= size; i += 128U)
+    {
+        __m256i v0 = _mm256_loadu_si256((const __m256i*) (data + i));
+        __m256i v1 = _mm256_loadu_si256((const __m256i*) (data + i + 32U));
+        __m256i v2 = _mm256_loadu_si256((const __m256i*) (data + i + 64U));
+        __m256i v3 = _mm256_loadu_si256((const __m256i*) (data + i + 96U));
+
+        // Check four vectors at once:
+        __m256i v = _mm256_or_si256(_mm256_or_si256(v0, v1), _mm256_or_si256(v2, v3));
+        if (!_mm256_testz_si256(v, v))
+        {
+            return false;
+        }
+    }
+
+    for (; i + 32U <= size; i += 32U)
+    {
+        __m256i v = _mm256_loadu_si256((const __m256i*) (data + i));
+        if (!_mm256_testz_si256(v, v))
+        {
+            return false;
+        }
+    }
+
+    return vector_is_zero_scalar(data + i, size - i);
+}
+
+bool vector_is_zero_sse2(const uint8_t* data, size_t size)
+{
+    const __m128i zero = _mm_setzero_si128();
+
+    size_t i = 0U;
+    for (; i + 64U <= size; i += 64U)
+    {
+        __m128i v0 = _mm_loadu_si128((const __m128i*) (data + i));
+        __m128i v1 = _mm_loadu_si128((const __m128i*) (data + i + 16U));
+        __m128i v2 = _mm_loadu_si128((const __m128i*) (data + i + 32U));
+        __m128i v3 = _mm_loadu_si128((const __m128i*) (data + i + 48U));
+
+        // NOTE: SSE2 has no PTEST, compare bytes with zero instead.
+        __m128i v = _mm_or_si128(_mm_or_si128(v0, v1), _mm_or_si128(v2, v3));
+        if (_mm_movemask_epi8(_mm_cmpeq_epi8(v, zero)) != 0xFFFF)
+        {
+            return false;
+        }
+    }
+
+    return vector_is_zero_scalar(data + i, size - i);
+}
+
+#endif // __x86_64__
+
+bool vector_is_zero(const uint8_t* data, size_t size)
+{
+#if defined(__x86_64__)
+    if (__builtin_cpu_supports("avx2"))
+    {
+        return vector_is_zero_avx2(data, size);
+    }
+
+    return vector_is_zero_sse2(data, size);
+#else
+    return vector_is_zero_scalar(data, size);
+#endif
+}
+
+#endif // MSUSEM_VECTOR_KERNELS
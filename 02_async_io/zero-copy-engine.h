@@ -0,0 +1,225 @@
+// No copyright. 2024, Vladislav Aleinik
+#ifndef MSUSEM_ZERO_COPY_ENGINE
+#define MSUSEM_ZERO_COPY_ENGINE
+
+#include "sync-engine.h"
+
+// In-kernel transfers:
+#include <sys/sendfile.h>
+
+//====================
+// In-kernel transfer
+//====================
+
+// Transfer methods ordered by fallback priority:
+typedef enum {
+    ZERO_COPY_FILE_RANGE = 0,
+    ZERO_COPY_SENDFILE   = 1,
+    ZERO_COPY_SPLICE     = 2,
+    ZERO_COPY_READ_WRITE = 3
+} ZeroCopyMethod;
+
+const char* ZERO_COPY_METHOD_NAMES[] = {
+    [ZERO_COPY_FILE_RANGE] = "copy_file_range",
+    [ZERO_COPY_SENDFILE]   = "sendfile",
+    [ZERO_COPY_SPLICE]     = "splice",
+    [ZERO_COPY_READ_WRITE] = "read/write"
+};
+
+struct ZeroCopyStatus
+{
+    ZeroCopyMethod method;
+
+    // Current file position of the destination (sendfile writes there):
+    uint64_t dst_pos;
+
+    // Pipe for splice():
+    int pipe_fds[2];
+    uint32_t pipe_size;
+
+    // Buffer for the read/write fallback:
+    uint8_t* buffer;
+};
+
+// Errors meaning that a method is not supported for the pair of files:
+bool zero_copy_unsupported(int error)
+{
+    return error == EXDEV || error == EINVAL || error == ENOSYS || error == EOPNOTSUPP;
+}
+
+// Move bytes from the source to the destination through the pipe:
+ssize_t zero_copy_splice(struct ZeroCopyStatus* status, struct CopyJob* job,
+                         uint64_t offset, uint32_t size)
+{
+    if (size > status->pipe_size)
+    {
+        size = status->pipe_size;
+    }
+
+    loff_t off_in = offset;
+    ssize_t in_pipe = splice(job->src_fd, &off_in, status->pipe_fds[1], NULL, size,
+                             SPLICE_F_MOVE|SPLICE_F_MORE);
+    if (in_pipe <= 0)
+    {
+        return in_pipe;
+    }
+
+    // Drain the pipe completely, so that it is empty for the next chunk:
+    loff_t off_out = offset;
+    for (ssize_t left = in_pipe; left > 0;)
+    {
+        ssize_t moved = splice(status->pipe_fds[0], NULL, job->dst_fd, &off_out, left, SPLICE_F_MOVE);
+        if (moved <= 0)
+        {
+            fprintf(stderr, "Unable to splice pipe into destination: errno=%i (%s)\n",
+                errno, strerror(errno));
+            exit(EXIT_FAILURE);
+        }
+
+        left -= moved;
+    }
+
+    return in_pipe;
+}
+
+// Transfer up to size bytes, return number of bytes or -1 with errno set:
+ssize_t zero_copy_transfer(const struct CopyConfig* config, struct ZeroCopyStatus* status,
+                           struct CopyJob* job, uint64_t offset, uint32_t size)
+{
+    switch (status->method)
+    {
+        case ZERO_COPY_FILE_RANGE:
+        {
+            loff_t off_in  = offset;
+            loff_t off_out = offset;
+            return copy_file_range(job->src_fd, &off_in, job->dst_fd, &off_out, size, 0U);
+        }
+        case ZERO_COPY_SENDFILE:
+        {
+            // Output offset is the file position of the destination:
+            if (status->dst_pos != offset && lseek(job->dst_fd, offset, SEEK_SET) == -1)
+            {
+                return -1;
+            }
+
+            off_t off_in = offset;
+            ssize_t sent = sendfile(job->dst_fd, job->src_fd, &off_in, size);
+
+            status->dst_pos = (sent > 0)? offset + sent : UINT64_MAX;
+            return sent;
+        }
+        case ZERO_COPY_SPLICE:
+        {
+            return zero_copy_splice(status, job, offset, size);
+        }
+        case ZERO_COPY_READ_WRITE:
+        {
+            sync_copy_block(config, job, status->buffer, offset, size);
+            return size;
+        }
+    }
+
+    return -1;
+}
+
+void zero_copy(const struct CopyConfig* config, struct CopyJob* job, ZeroCopyMethod method)
+{
+    struct ZeroCopyStatus status = {
+        .method    = method,
+        .dst_pos   = UINT64_MAX,
+        .pipe_fds  = {-1, -1},
+        .pipe_size = 0U,
+        .buffer    = NULL
+    };
+
+    if (pipe(status.pipe_fds) == -1)
+    {
+        fprintf(stderr, "Unable to create pipe: errno=%i (%s)\n", errno, strerror(errno));
+        exit(EXIT_FAILURE);
+    }
+
+    // Try to fit the whole block into the pipe:
+    int pipe_size = fcntl(status.pipe_fds[1], F_SETPIPE_SZ, config->block_size);
+    if (pipe_size == -1)
+    {
+        pipe_size = fcntl(status.pipe_fds[1], F_GETPIPE_SZ);
+    }
+
+    status.pipe_size = pipe_size;
+
+    uint64_t offset;
+    uint32_t size;
+    while (copy_job_next_block(job, config->block_size, &offset, &size))
+    {
+        for (uint32_t done = 0U; done < size;)
+        {
+            ssize_t copied = zero_copy_transfer(config, &status, job, offset + done, size - done);
+            if (copied == -1 && done == 0U && zero_copy_unsupported(errno))
+            {
+                // Fall back to the next method for this block and all the rest:
+                fprintf(stderr, "%s is not supported (errno=%i: %s), falling back to %s\n",
+                    ZERO_COPY_METHOD_NAMES[status.method], errno, strerror(errno),
+                    ZERO_COPY_METHOD_NAMES[status.method + 1U]);
+
+                status.method += 1U;
+                if (status.method == ZERO_COPY_READ_WRITE)
+                {
+                    status.buffer = copy_alloc_buffers(config, 1U);
+                }
+
+                continue;
+            }
+
+            if (copied <= 0)
+            {
+                fprintf(stderr, "Unable to copy block [%lx, %lx) with %s: errno=%i (%s)\n",
+                    offset, offset + size, ZERO_COPY_METHOD_NAMES[status.method],
+                    errno, strerror(errno));
+                exit(EXIT_FAILURE);
+            }
+
+            done += copied;
+        }
+    }
+
+    close(status.pipe_fds[0]);
+    close(status.pipe_fds[1]);
+
+    free(status.buffer);
+}
+
+//===================
+// Zero-copy engines
+//===================
+
+void copy_file_range_copy(const struct CopyConfig* config, struct CopyJob* job)
+{
+    zero_copy(config, job, ZERO_COPY_FILE_RANGE);
+}
+
+void sendfile_copy(const struct CopyConfig* config, struct CopyJob* job)
+{
+    zero_copy(config, job, ZERO_COPY_SENDFILE);
+}
+
+void splice_copy(const struct CopyConfig* config, struct CopyJob* job)
+{
+    zero_copy(config, job, ZERO_COPY_SPLICE);
+}
+
+const struct CopyEngine COPY_FILE_RANGE_ENGINE = {
+    .name = "copy-file-range",
+    .copy = copy_file_range_copy
+};
+
+const struct CopyEngine SENDFILE_ENGINE = {
+    .name = "sendfile",
+    .copy = sendfile_copy
+};
+
+const struct CopyEngine SPLICE_ENGINE = {
+    .name = "splice",
+    .copy = splice_copy
+};
+
+#endif // MSUSEM_ZERO_COPY_ENGINE
@@ -5,14 +5,17 @@
 
 #include <stdlib.h>
 #include <stdint.h>
+#include <stdbool.h>
 #include <stdio.h>
 
-// CPU_SET macros:
-#include <sched.h>
 // Threads:
 #include <pthread.h>
 // Atomics:
 #include <stdatomic.h>
+// Persistent worker pool:
+#include "../01_pthreads_sync/worker-pool.h"
+// Memory ordering ablation:
+#include "../01_pthreads_sync/memory-ordering.h"
 
 //======================
 // Benchmark parameters
@@ -71,6 +74,8 @@ void queue_init(QUEUE* queue, uint32_t size)
         exit(EXIT_FAILURE);
     }
 
+    queue->mask = size - 1U;
+
     queue->cached_head = 0U;
     queue->cached_tail = 0U;
     queue->head = 0U;
@@ -79,11 +84,11 @@ void queue_init(QUEUE* queue, uint32_t size)
 
 bool queue_enqueue(QUEUE* queue, uint64_t elem)
 {
-    uint32_t tail = atomic_load_explicit(&queue->tail, memory_order_relaxed);
+    uint32_t tail = ordered_load(&queue->tail, memory_order_relaxed);
 
     if ((int32_t)(tail - (queue->cached_head + queue->mask)) > 0)
     {
-        uint32_t cached_head = atomic_load_explicit(&queue->head, memory_order_relaxed);
+        uint32_t cached_head = ordered_load(&queue->head, memory_order_relaxed);
 
         queue->cached_head = cached_head;
 
@@ -94,7 +99,7 @@ bool queue_enqueue(QUEUE* queue, uint64_t elem)
     }
 
     queue->data[tail & queue->mask] = elem;
-    atomic_store_explicit(&queue->tail, tail + 1, memory_order_release);
+    ordered_store(&queue->tail, tail + 1, memory_order_release);
 
     return true;
 }
@@ -102,11 +107,11 @@ bool queue_enqueue(QUEUE* queue, uint64_t elem)
 bool queue_dequeue(QUEUE* queue, uint64_t* elem)
 {
     // Read value of buffer head:
-    uint32_t head = atomic_load_explicit(&queue->head, memory_order_relaxed);
+    uint32_t head = ordered_load(&queue->head, memory_order_relaxed);
 
     if (queue->cached_tail == head)
     {
-        uint32_t cached_tail = atomic_load_explicit(&queue->tail, memory_order_acquire);
+        uint32_t cached_tail = ordered_load(&queue->tail, memory_order_acquire);
         queue->cached_tail = cached_tail;
 
         if (cached_tail == head)
@@ -116,16 +121,16 @@ bool queue_dequeue(QUEUE* queue, uint64_t* elem)
     }
 
     *elem = queue->data[head & queue->mask];
-    atomic_store_explicit(&queue->head, head + 1, memory_order_relaxed);
+    ordered_store(&queue->head, head + 1, memory_order_relaxed);
 
     return true;
 }
 
 bool queue_enqueue_simple(QUEUE* queue, uint64_t elem)
 {
-    uint32_t head = atomic_load_explicit(&queue->head, memory_order_relaxed);
+    uint32_t head = ordered_load(&queue->head, memory_order_relaxed);
 
-    uint32_t tail = atomic_load_explicit(&queue->tail, memory_order_relaxed);
+    uint32_t tail = ordered_load(&queue->tail, memory_order_relaxed);
 
     if ((int32_t)(tail - (head + queue->mask)) > 0)
     {
@@ -133,23 +138,23 @@ bool queue_enqueue_simple(QUEUE* queue, uint64_t elem)
     }
 
     queue->data[tail & queue->mask] = elem; // (1)
-    atomic_store_explicit(&queue->tail, tail + 1, memory_order_release); // (2)
+    ordered_store(&queue->tail, tail + 1, memory_order_release); // (2)
 
     return true;
 }
 
 bool queue_dequeue_simple(QUEUE* queue, uint64_t* elem)
 {
-    uint32_t head = atomic_load_explicit(&queue->head, memory_order_relaxed);
+    uint32_t head = ordered_load(&queue->head, memory_order_relaxed);
 
-    uint32_t tail = atomic_load_explicit(&queue->tail, memory_order_acquire); // (3)
+    uint32_t tail = ordered_load(&queue->tail, memory_order_acquire); // (3)
     if (tail == head)
     {
         return false;
     }
 
     *elem = queue->data[head & queue->mask]; // (4)
-    atomic_store_explicit(&queue->head, head + 1, memory_order_relaxed);
+    ordered_store(&queue->head, head + 1, memory_order_relaxed);
 
     return true;
 }
@@ -248,10 +253,6 @@ void* thread_func(void* thread_args)
 
 #define NUM_THREADS 2U
 
-typedef struct {
-    pthread_t tid;
-} THREAD_INFO;
-
 int main()
 {
     // Initialize queue:
@@ -266,59 +267,29 @@ int main()
         args[i].queue = &queue;
     }
 
-    // Spawn threads:
-    THREAD_INFO thread_info[NUM_THREADS];
+    // Start persistent worker pool:
+    WORKER_POOL pool;
+    worker_pool_init(&pool, NUM_THREADS, NUM_HARDWARE_THREADS);
+
+    double start_ns = worker_pool_time_ns();
+
+    // Submit work to pool workers:
     for (size_t i = 0U; i < NUM_THREADS; ++i)
     {
-        // Initialize thread attributes:
-        pthread_attr_t thread_attributes;
-        int ret = pthread_attr_init(&thread_attributes);
-        if (ret != 0)
-        {
-            fprintf(stderr, "Unable to call pthread_attr_init\n");
-            exit(EXIT_FAILURE);
-        }
+        worker_pool_submit(&pool, i, thread_func, &args[i]);
+    }
 
-        // Assign hardware thread to posix thread:
-        cpu_set_t assigned_harts;
-        CPU_ZERO(&assigned_harts);
+    // Wait for all workers to finish execution:
+    worker_pool_wait(&pool);
 
-        // Assumptions:
-        // - There are NUM_HARDWARE_THREADS hardware threads.
-        // - All harts from 0 to are present.
-        size_t hart_i = i % NUM_HARDWARE_THREADS;
-        CPU_SET(hart_i, &assigned_harts);
+    double elapsed_ns = worker_pool_time_ns() - start_ns;
 
-        // Set thread affinity:
-        ret = pthread_attr_setaffinity_np(&thread_attributes, sizeof(cpu_set_t), &assigned_harts);
-        if (ret != 0)
-        {
-            fprintf(stderr, "Unable to call pthread_attr_setaffinity_np\n");
-            exit(EXIT_FAILURE);
-        }
+    // Stop worker threads:
+    worker_pool_destroy(&pool);
 
-        // Create POSIX thread:
-        ret = pthread_create(&thread_info[i].tid, &thread_attributes, thread_func, &args[i]);
-        if (ret != 0)
-        {
-            fprintf(stderr, "Unable to create thread\n");
-            exit(EXIT_FAILURE);
-        }
-
-        // Destroy thread attribute object:
-        pthread_attr_destroy(&thread_attributes);
-    }
-
-    // Wait for all threads to finish execution:
-    for (size_t i = 0; i < NUM_THREADS; ++i)
-    {
-        int ret = pthread_join(thread_info[i].tid, NULL);
-        if (ret != 0)
-        {
-            fprintf(stderr, "Unable to join thread\n");
-            exit(EXIT_FAILURE);
-        }
-    }
+    printf("Memory ordering %s: %.2f Mops/s (%.2f ns/op)\n",
+        MEMORY_ORDERING_NAME, NUM_ITERATIONS / elapsed_ns * 1e3,
+        elapsed_ns / NUM_ITERATIONS);
 
     return EXIT_SUCCESS;
 }
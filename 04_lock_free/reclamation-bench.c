@@ -0,0 +1,383 @@
+// No copyright. Vladislav Alenik, 2024
+
+// Feature test macro:
+#define _GNU_SOURCE
+
+#include "reclamation.h"
+
+// CPU_SET macros:
+#include <sched.h>
+// Threads:
+#include <pthread.h>
+// Time measurement:
+#include <time.h>
+
+//======================
+// Benchmark parameters
+//======================
+
+#define NUM_THREADS 8U
+#define NUM_HARDWARE_THREADS 8U
+
+#define NUM_ITERATIONS 1000000U
+
+// Size of a single stack node (affects unreclaimed memory):
+#define NODE_SIZE 64U
+
+//---------------------------------
+// Lock-free stack (Treiber stack)
+//---------------------------------
+
+typedef struct NODE {
+    struct NODE* next;
+    uint64_t value;
+    uint8_t payload[NODE_SIZE - sizeof(struct NODE*) - sizeof(uint64_t)];
+} NODE;
+
+typedef struct {
+    NODE* _Atomic top;
+} STACK;
+
+void stack_push(STACK* stack, NODE* node)
+{
+    NODE* top = atomic_load_explicit(&stack->top, memory_order_relaxed);
+    do
+    {
+        node->next = top;
+    }
+    while (!atomic_compare_exchange_weak_explicit(&stack->top, &top, node,
+        memory_order_release, memory_order_relaxed));
+}
+
+// NOTE: caller must keep popped nodes alive until no one can access them.
+NODE* stack_pop_unprotected(STACK* stack)
+{
+    NODE* top = atomic_load_explicit(&stack->top, memory_order_acquire);
+    while (top != NULL)
+    {
+        // Dereference of top is the reason for memory reclamation:
+        NODE* next = top->next;
+
+        if (atomic_compare_exchange_weak_explicit(&stack->top, &top, next,
+            memory_order_acquire, memory_order_acquire))
+        {
+            break;
+        }
+    }
+
+    return top;
+}
+
+NODE* stack_pop_hazard(STACK* stack, HP_DOMAIN* domain, size_t thread_i)
+{
+    while (true)
+    {
+        NODE* top = hp_protect(domain, thread_i, 0U, (void* _Atomic*) &stack->top);
+        if (top == NULL)
+        {
+            return NULL;
+        }
+
+        NODE* next = top->next;
+
+        if (atomic_compare_exchange_strong_explicit(&stack->top, &top, next,
+            memory_order_acquire, memory_order_relaxed))
+        {
+            hp_clear(domain, thread_i, 0U);
+            return top;
+        }
+    }
+}
+
+//------------------
+// Reclamation mode
+//------------------
+
+typedef enum {
+    // Leak popped nodes until the end of the run (zero-overhead baseline):
+    RECLAIM_DEFERRED = 0,
+    RECLAIM_HAZARD   = 1,
+    RECLAIM_EPOCH    = 2
+} RECLAIM_MODE;
+
+const char* RECLAIM_MODE_NAMES[] = {
+    [RECLAIM_DEFERRED] = "deferred",
+    [RECLAIM_HAZARD]   = "hazard pointers",
+    [RECLAIM_EPOCH]    = "epoch-based"
+};
+
+//------------------
+// Thread execution
+//------------------
+
+typedef struct {
+    size_t thread_i;
+    RECLAIM_MODE mode;
+
+    STACK* stack;
+    HP_DOMAIN* hp_domain;
+    EBR_DOMAIN* ebr_domain;
+    RETIRE_LIST* deferred;
+
+    // Stalled thread holds a reference until all the others finish:
+    bool stalled;
+    _Atomic size_t* num_finished;
+} THREAD_ARGS;
+
+void stall_thread(THREAD_ARGS* args)
+{
+    if (args->mode == RECLAIM_HAZARD)
+    {
+        hp_protect(args->hp_domain, args->thread_i, 0U, (void* _Atomic*) &args->stack->top);
+    }
+    else if (args->mode == RECLAIM_EPOCH)
+    {
+        ebr_enter(args->ebr_domain, args->thread_i);
+    }
+
+    while (atomic_load_explicit(args->num_finished, memory_order_acquire) != NUM_THREADS - 1U)
+    {
+        sched_yield();
+    }
+
+    if (args->mode == RECLAIM_HAZARD)
+    {
+        hp_clear(args->hp_domain, args->thread_i, 0U);
+    }
+    else if (args->mode == RECLAIM_EPOCH)
+    {
+        ebr_exit(args->ebr_domain, args->thread_i);
+    }
+}
+
+void* thread_func(void* thread_args)
+{
+    THREAD_ARGS* args = (THREAD_ARGS*) thread_args;
+
+    if (args->stalled)
+    {
+        stall_thread(args);
+        return NULL;
+    }
+
+    for (size_t i = 0U; i < NUM_ITERATIONS; ++i)
+    {
+        NODE* node = malloc(sizeof(NODE));
+        if (node == NULL)
+        {
+            fprintf(stderr, "Unable to allocate stack node\n");
+            exit(EXIT_FAILURE);
+        }
+
+        node->value = i;
+        stack_push(args->stack, node);
+
+        NODE* popped = NULL;
+        switch (args->mode)
+        {
+            case RECLAIM_DEFERRED:
+            {
+                popped = stack_pop_unprotected(args->stack);
+                if (popped != NULL)
+                {
+                    retire_list_push(args->deferred, popped, 0U);
+                }
+                break;
+            }
+            case RECLAIM_HAZARD:
+            {
+                popped = stack_pop_hazard(args->stack, args->hp_domain, args->thread_i);
+                if (popped != NULL)
+                {
+                    hp_retire(args->hp_domain, args->thread_i, popped);
+                }
+                break;
+            }
+            case RECLAIM_EPOCH:
+            {
+                ebr_enter(args->ebr_domain, args->thread_i);
+
+                popped = stack_pop_unprotected(args->stack);
+                if (popped != NULL)
+                {
+                    ebr_retire(args->ebr_domain, args->thread_i, popped);
+                }
+
+                ebr_exit(args->ebr_domain, args->thread_i);
+                break;
+            }
+        }
+    }
+
+    atomic_fetch_add_explicit(args->num_finished, 1U, memory_order_release);
+
+    return NULL;
+}
+
+//------------------
+// Thread benchmark
+//------------------
+
+typedef struct {
+    pthread_t tid;
+} THREAD_INFO;
+
+double get_time_ns()
+{
+    struct timespec time;
+    clock_gettime(CLOCK_MONOTONIC, &time);
+
+    return 1e9 * time.tv_sec + time.tv_nsec;
+}
+
+void run_benchmark(RECLAIM_MODE mode, bool with_stalled_thread)
+{
+    // Initialize shared data structures:
+    STACK stack;
+    atomic_init(&stack.top, NULL);
+
+    HP_DOMAIN hp_domain;
+    hp_init(&hp_domain, NUM_THREADS, free);
+
+    EBR_DOMAIN ebr_domain;
+    ebr_init(&ebr_domain, NUM_THREADS, free);
+
+    RETIRE_LIST deferred[NUM_THREADS];
+
+    _Atomic size_t num_finished = 0U;
+
+    // Initialize thread data:
+    THREAD_ARGS args[NUM_THREADS];
+    for (size_t i = 0U; i < NUM_THREADS; ++i)
+    {
+        deferred[i] = (RETIRE_LIST) {.nodes = NULL, .size = 0U, .capacity = 0U};
+
+        args[i] = (THREAD_ARGS) {
+            .thread_i     = i,
+            .mode         = mode,
+            .stack        = &stack,
+            .hp_domain    = &hp_domain,
+            .ebr_domain   = &ebr_domain,
+            .deferred     = &deferred[i],
+            .stalled      = with_stalled_thread && (i == 0U),
+            .num_finished = &num_finished
+        };
+    }
+
+    double start_ns = get_time_ns();
+
+    // Spawn threads:
+    THREAD_INFO thread_info[NUM_THREADS];
+    for (size_t i = 0U; i < NUM_THREADS; ++i)
+    {
+        // Initialize thread attributes:
+        pthread_attr_t thread_attributes;
+        int ret = pthread_attr_init(&thread_attributes);
+        if (ret != 0)
+        {
+            fprintf(stderr, "Unable to call pthread_attr_init\n");
+            exit(EXIT_FAILURE);
+        }
+
+        // Assign hardware thread to posix thread:
+        cpu_set_t assigned_harts;
+        CPU_ZERO(&assigned_harts);
+
+        // Assumptions:
+        // - There are NUM_HARDWARE_THREADS hardware threads.
+        // - All harts from 0 to are present.
+        size_t hart_i = i % NUM_HARDWARE_THREADS;
+        CPU_SET(hart_i, &assigned_harts);
+
+        // Set thread affinity:
+        ret = pthread_attr_setaffinity_np(&thread_attributes, sizeof(cpu_set_t), &assigned_harts);
+        if (ret != 0)
+        {
+            fprintf(stderr, "Unable to call pthread_attr_setaffinity_np\n");
+            exit(EXIT_FAILURE);
+        }
+
+        // Create POSIX thread:
+        ret = pthread_create(&thread_info[i].tid, &thread_attributes, thread_func, &args[i]);
+        if (ret != 0)
+        {
+            fprintf(stderr, "Unable to create thread\n");
+            exit(EXIT_FAILURE);
+        }
+
+        // Destroy thread attribute object:
+        pthread_attr_destroy(&thread_attributes);
+    }
+
+    // Wait for all threads to finish execution:
+    for (size_t i = 0; i < NUM_THREADS; ++i)
+    {
+        int ret = pthread_join(thread_info[i].tid, NULL);
+        if (ret != 0)
+        {
+            fprintf(stderr, "Unable to join thread\n");
+            exit(EXIT_FAILURE);
+        }
+    }
+
+    double elapsed_ns = get_time_ns() - start_ns;
+
+    // Collect statistics:
+    // NOTE: per-thread peaks are summed up, so the result is an upper bound.
+    size_t peak_unreclaimed = 0U;
+    uint64_t num_scans = 0U;
+    for (size_t i = 0U; i < NUM_THREADS; ++i)
+    {
+        switch (mode)
+        {
+            case RECLAIM_DEFERRED:
+                peak_unreclaimed += deferred[i].size;
+                break;
+            case RECLAIM_HAZARD:
+                peak_unreclaimed += hp_domain.records[i].stats.peak_unreclaimed;
+                num_scans        += hp_domain.records[i].stats.num_scans;
+                break;
+            case RECLAIM_EPOCH:
+                peak_unreclaimed += ebr_domain.records[i].stats.peak_unreclaimed;
+                num_scans        += ebr_domain.records[i].stats.num_scans;
+                break;
+        }
+    }
+
+    printf("%-16s %-8s %8.1f ns/op %10zu nodes %10.2f MiB %8lu scans\n",
+        RECLAIM_MODE_NAMES[mode],
+        with_stalled_thread? "stalled" : "normal",
+        elapsed_ns / NUM_ITERATIONS,
+        peak_unreclaimed,
+        (double) peak_unreclaimed * sizeof(NODE) / (1024.0 * 1024.0),
+        num_scans);
+
+    // Free everything left:
+    for (NODE* node = stack_pop_unprotected(&stack); node != NULL; node = stack_pop_unprotected(&stack))
+    {
+        free(node);
+    }
+
+    for (size_t i = 0U; i < NUM_THREADS; ++i)
+    {
+        RECLAIM_STATS stats = {0};
+        retire_list_free_all(&deferred[i], &stats, free);
+    }
+
+    hp_free_domain(&hp_domain);
+    ebr_free_domain(&ebr_domain);
+}
+
+int main()
+{
+    printf("%-16s %-8s %14s %16s %14s %14s\n",
+        "Reclamation", "Scenario", "Latency", "Peak unreclaimed", "Peak memory", "Batch frees");
+
+    for (RECLAIM_MODE mode = RECLAIM_DEFERRED; mode <= RECLAIM_EPOCH; ++mode)
+    {
+        run_benchmark(mode, false);
+        run_benchmark(mode, true);
+    }
+
+    return EXIT_SUCCESS;
+}
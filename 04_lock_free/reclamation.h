@@ -0,0 +1,420 @@
+// No copyright. Vladislav Alenik, 2024
+#ifndef MSUSEM_RECLAMATION
+#define MSUSEM_RECLAMATION
+
+// Feature test macro:
+#define _GNU_SOURCE
+
+#include <stdlib.h>
+#include <stdint.h>
+#include <stdbool.h>
+#include <stdio.h>
+#include <string.h>
+
+// Atomics:
+#include <stdatomic.h>
+
+//========================
+// Reclamation parameters
+//========================
+
+// Per-thread records are padded to avoid false sharing.
+// NOTE: 128 bytes cover adjacent cache line prefetch on x86.
+#define RECLAIM_ALIGNMENT 128U
+
+// Number of hazard pointers owned by a single thread:
+#define HP_SLOTS_PER_THREAD 4U
+
+// Minimal length of a retire list to trigger a batch free:
+#define RETIRE_BATCH_SIZE 128U
+
+//==============
+// Retire lists
+//==============
+
+typedef struct {
+    void* ptr;
+    // Global epoch at the moment of retirement (used by EBR only):
+    uint64_t epoch;
+} RETIRED_NODE;
+
+typedef struct {
+    RETIRED_NODE* nodes;
+    size_t size;
+    size_t capacity;
+} RETIRE_LIST;
+
+typedef struct {
+    uint64_t num_retired;
+    uint64_t num_freed;
+    uint64_t num_scans;
+    size_t peak_unreclaimed;
+} RECLAIM_STATS;
+
+void retire_list_push(RETIRE_LIST* list, void* ptr, uint64_t epoch)
+{
+    if (list->size == list->capacity)
+    {
+        size_t new_capacity = (list->capacity == 0U)? RETIRE_BATCH_SIZE : 2U * list->capacity;
+
+        RETIRED_NODE* new_nodes = realloc(list->nodes, new_capacity * sizeof(RETIRED_NODE));
+        if (new_nodes == NULL)
+        {
+            fprintf(stderr, "Unable to grow retire list to %zu nodes\n", new_capacity);
+            exit(EXIT_FAILURE);
+        }
+
+        list->nodes    = new_nodes;
+        list->capacity = new_capacity;
+    }
+
+    list->nodes[list->size].ptr   = ptr;
+    list->nodes[list->size].epoch = epoch;
+    list->size += 1U;
+}
+
+void retire_list_free_all(RETIRE_LIST* list, RECLAIM_STATS* stats, void (*free_func)(void*))
+{
+    for (size_t i = 0U; i < list->size; ++i)
+    {
+        free_func(list->nodes[i].ptr);
+    }
+
+    stats->num_freed += list->size;
+
+    free(list->nodes);
+    list->nodes    = NULL;
+    list->size     = 0U;
+    list->capacity = 0U;
+}
+
+static inline void reclaim_stats_update_peak(RECLAIM_STATS* stats, size_t unreclaimed)
+{
+    if (unreclaimed > stats->peak_unreclaimed)
+    {
+        stats->peak_unreclaimed = unreclaimed;
+    }
+}
+
+void* reclaim_alloc_records(size_t num_records, size_t record_size)
+{
+    void* records = aligned_alloc(RECLAIM_ALIGNMENT, num_records * record_size);
+    if (records == NULL)
+    {
+        fprintf(stderr, "Unable to allocate %zu reclamation records\n", num_records);
+        exit(EXIT_FAILURE);
+    }
+
+    return records;
+}
+
+//=================
+// Hazard pointers
+//=================
+
+typedef struct {
+    _Alignas(RECLAIM_ALIGNMENT) void* _Atomic slots[HP_SLOTS_PER_THREAD];
+
+    RETIRE_LIST retired;
+    RECLAIM_STATS stats;
+
+    // Scratch space for the hazards snapshot taken during scan:
+    void** snapshot;
+} HP_RECORD;
+
+typedef struct {
+    size_t num_threads;
+    HP_RECORD* records;
+
+    void (*free_func)(void* ptr);
+
+    // Scan is amortized over at least this many retired nodes:
+    size_t scan_threshold;
+} HP_DOMAIN;
+
+void hp_init(HP_DOMAIN* domain, size_t num_threads, void (*free_func)(void*))
+{
+    domain->num_threads = num_threads;
+    domain->free_func   = free_func;
+
+    // Keep scan cost O(1) per retired node:
+    size_t num_hazards = num_threads * HP_SLOTS_PER_THREAD;
+    domain->scan_threshold = (2U * num_hazards > RETIRE_BATCH_SIZE)? 2U * num_hazards : RETIRE_BATCH_SIZE;
+
+    domain->records = reclaim_alloc_records(num_threads, sizeof(HP_RECORD));
+    for (size_t thr_i = 0U; thr_i < num_threads; ++thr_i)
+    {
+        HP_RECORD* record = &domain->records[thr_i];
+
+        for (size_t slot_i = 0U; slot_i < HP_SLOTS_PER_THREAD; ++slot_i)
+        {
+            atomic_init(&record->slots[slot_i], NULL);
+        }
+
+        record->retired = (RETIRE_LIST) {.nodes = NULL, .size = 0U, .capacity = 0U};
+        record->stats   = (RECLAIM_STATS) {0};
+
+        record->snapshot = calloc(num_hazards, sizeof(void*));
+        if (record->snapshot == NULL)
+        {
+            fprintf(stderr, "Unable to allocate hazard pointer snapshot\n");
+            exit(EXIT_FAILURE);
+        }
+    }
+}
+
+// NOTE: all threads are expected to be quiescent.
+void hp_free_domain(HP_DOMAIN* domain)
+{
+    for (size_t thr_i = 0U; thr_i < domain->num_threads; ++thr_i)
+    {
+        HP_RECORD* record = &domain->records[thr_i];
+
+        retire_list_free_all(&record->retired, &record->stats, domain->free_func);
+        free(record->snapshot);
+    }
+
+    free(domain->records);
+}
+
+// Publish a hazard pointer to the node currently stored in src:
+void* hp_protect(HP_DOMAIN* domain, size_t thread_i, size_t slot_i, void* _Atomic* src)
+{
+    void* _Atomic* slot = &domain->records[thread_i].slots[slot_i];
+
+    void* ptr = atomic_load_explicit(src, memory_order_relaxed);
+    while (true)
+    {
+        // Store-load ordering is required here, hence seq_cst:
+        atomic_store_explicit(slot, ptr, memory_order_seq_cst);
+
+        void* validated = atomic_load_explicit(src, memory_order_seq_cst);
+        if (validated == ptr)
+        {
+            return ptr;
+        }
+
+        ptr = validated;
+    }
+}
+
+void hp_clear(HP_DOMAIN* domain, size_t thread_i, size_t slot_i)
+{
+    atomic_store_explicit(&domain->records[thread_i].slots[slot_i], NULL, memory_order_release);
+}
+
+static int hp_compare_ptrs(const void* a, const void* b)
+{
+    uintptr_t ptr_a = (uintptr_t) *(void* const*) a;
+    uintptr_t ptr_b = (uintptr_t) *(void* const*) b;
+
+    return (ptr_a > ptr_b) - (ptr_a < ptr_b);
+}
+
+// Free every retired node not protected by any hazard pointer:
+void hp_scan(HP_DOMAIN* domain, size_t thread_i)
+{
+    HP_RECORD* record = &domain->records[thread_i];
+
+    // Pairs with the seq_cst store in hp_protect:
+    atomic_thread_fence(memory_order_seq_cst);
+
+    // Take a snapshot of all published hazards:
+    size_t num_hazards = 0U;
+    for (size_t thr_i = 0U; thr_i < domain->num_threads; ++thr_i)
+    {
+        for (size_t slot_i = 0U; slot_i < HP_SLOTS_PER_THREAD; ++slot_i)
+        {
+            void* hazard = atomic_load_explicit(&domain->records[thr_i].slots[slot_i], memory_order_acquire);
+            if (hazard != NULL)
+            {
+                record->snapshot[num_hazards++] = hazard;
+            }
+        }
+    }
+
+    qsort(record->snapshot, num_hazards, sizeof(void*), hp_compare_ptrs);
+
+    // Free unprotected nodes and compact the rest:
+    size_t num_kept = 0U;
+    for (size_t node_i = 0U; node_i < record->retired.size; ++node_i)
+    {
+        RETIRED_NODE node = record->retired.nodes[node_i];
+
+        if (bsearch(&node.ptr, record->snapshot, num_hazards, sizeof(void*), hp_compare_ptrs) != NULL)
+        {
+            record->retired.nodes[num_kept++] = node;
+        }
+        else
+        {
+            domain->free_func(node.ptr);
+        }
+    }
+
+    record->stats.num_freed += record->retired.size - num_kept;
+    record->stats.num_scans += 1U;
+
+    record->retired.size = num_kept;
+}
+
+void hp_retire(HP_DOMAIN* domain, size_t thread_i, void* ptr)
+{
+    HP_RECORD* record = &domain->records[thread_i];
+
+    retire_list_push(&record->retired, ptr, 0U);
+
+    record->stats.num_retired += 1U;
+    reclaim_stats_update_peak(&record->stats, record->retired.size);
+
+    if (record->retired.size >= domain->scan_threshold)
+    {
+        hp_scan(domain, thread_i);
+    }
+}
+
+//=========================
+// Epoch-based reclamation
+//=========================
+
+// Local epoch layout: (epoch << 1) | EBR_ACTIVE.
+#define EBR_ACTIVE 1ULL
+
+typedef struct {
+    _Alignas(RECLAIM_ALIGNMENT) _Atomic uint64_t local_epoch;
+
+    // Global epoch observed by the last collection:
+    uint64_t collect_epoch;
+
+    RETIRE_LIST retired;
+    RECLAIM_STATS stats;
+} EBR_RECORD;
+
+typedef struct {
+    _Alignas(RECLAIM_ALIGNMENT) _Atomic uint64_t global_epoch;
+
+    size_t num_threads;
+    EBR_RECORD* records;
+
+    void (*free_func)(void* ptr);
+} EBR_DOMAIN;
+
+void ebr_init(EBR_DOMAIN* domain, size_t num_threads, void (*free_func)(void*))
+{
+    atomic_init(&domain->global_epoch, 0U);
+
+    domain->num_threads = num_threads;
+    domain->free_func   = free_func;
+
+    domain->records = reclaim_alloc_records(num_threads, sizeof(EBR_RECORD));
+    for (size_t thr_i = 0U; thr_i < num_threads; ++thr_i)
+    {
+        EBR_RECORD* record = &domain->records[thr_i];
+
+        atomic_init(&record->local_epoch, 0U);
+        record->collect_epoch = 0U;
+
+        record->retired = (RETIRE_LIST) {.nodes = NULL, .size = 0U, .capacity = 0U};
+        record->stats   = (RECLAIM_STATS) {0};
+    }
+}
+
+// NOTE: all threads are expected to be quiescent.
+void ebr_free_domain(EBR_DOMAIN* domain)
+{
+    for (size_t thr_i = 0U; thr_i < domain->num_threads; ++thr_i)
+    {
+        EBR_RECORD* record = &domain->records[thr_i];
+
+        retire_list_free_all(&record->retired, &record->stats, domain->free_func);
+    }
+
+    free(domain->records);
+}
+
+// Enter critical section (shared pointers may be dereferenced inside):
+void ebr_enter(EBR_DOMAIN* domain, size_t thread_i)
+{
+    uint64_t epoch = atomic_load_explicit(&domain->global_epoch, memory_order_relaxed);
+
+    atomic_store_explicit(&domain->records[thread_i].local_epoch, (epoch << 1U) | EBR_ACTIVE, memory_order_relaxed);
+
+    // Announcement must be visible before any shared pointer is read:
+    atomic_thread_fence(memory_order_seq_cst);
+}
+
+void ebr_exit(EBR_DOMAIN* domain, size_t thread_i)
+{
+    atomic_store_explicit(&domain->records[thread_i].local_epoch, 0U, memory_order_release);
+}
+
+// Advance global epoch if every active thread has observed it:
+bool ebr_try_advance(EBR_DOMAIN* domain)
+{
+    atomic_thread_fence(memory_order_seq_cst);
+
+    uint64_t epoch = atomic_load_explicit(&domain->global_epoch, memory_order_relaxed);
+
+    for (size_t thr_i = 0U; thr_i < domain->num_threads; ++thr_i)
+    {
+        uint64_t local = atomic_load_explicit(&domain->records[thr_i].local_epoch, memory_order_acquire);
+
+        if ((local & EBR_ACTIVE) != 0U && (local >> 1U) != epoch)
+        {
+            return false;
+        }
+    }
+
+    return atomic_compare_exchange_strong_explicit(&domain->global_epoch, &epoch, epoch + 1U,
+        memory_order_acq_rel, memory_order_relaxed);
+}
+
+// Free nodes retired at least two epochs ago:
+void ebr_collect(EBR_DOMAIN* domain, size_t thread_i)
+{
+    EBR_RECORD* record = &domain->records[thread_i];
+
+    uint64_t epoch = atomic_load_explicit(&domain->global_epoch, memory_order_acquire);
+    if (epoch == record->collect_epoch)
+    {
+        // Nothing became safe since the last collection (i.e. a thread is stalled):
+        return;
+    }
+
+    record->collect_epoch = epoch;
+
+    // Retire list is sorted by epoch, so safe nodes form a prefix:
+    size_t num_freed = 0U;
+    while (num_freed < record->retired.size && record->retired.nodes[num_freed].epoch + 2U <= epoch)
+    {
+        domain->free_func(record->retired.nodes[num_freed].ptr);
+        num_freed += 1U;
+    }
+
+    memmove(record->retired.nodes, &record->retired.nodes[num_freed],
+        (record->retired.size - num_freed) * sizeof(RETIRED_NODE));
+
+    record->stats.num_freed += num_freed;
+    record->stats.num_scans += 1U;
+
+    record->retired.size -= num_freed;
+}
+
+// NOTE: node must already be unlinked from the shared structure.
+void ebr_retire(EBR_DOMAIN* domain, size_t thread_i, void* ptr)
+{
+    EBR_RECORD* record = &domain->records[thread_i];
+
+    uint64_t epoch = atomic_load_explicit(&domain->global_epoch, memory_order_acquire);
+    retire_list_push(&record->retired, ptr, epoch);
+
+    record->stats.num_retired += 1U;
+    reclaim_stats_update_peak(&record->stats, record->retired.size);
+
+    if (record->retired.size % RETIRE_BATCH_SIZE == 0U)
+    {
+        ebr_try_advance(domain);
+        ebr_collect(domain, thread_i);
+    }
+}
+
+#endif // MSUSEM_RECLAMATION
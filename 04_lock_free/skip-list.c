@@ -0,0 +1,692 @@
+// No copyright. Vladislav Alenik, 2024
+
+// Feature test macro:
+#define _GNU_SOURCE
+
+#include <stdlib.h>
+#include <stdint.h>
+#include <stdbool.h>
+#include <stdio.h>
+
+// Threads:
+#include <pthread.h>
+// Atomics:
+#include <stdatomic.h>
+// Persistent worker pool:
+#include "../01_pthreads_sync/worker-pool.h"
+// Per-node spinlocks:
+#include "../01_pthreads_sync/tas-lock.h"
+
+//======================
+// Benchmark parameters
+//======================
+
+#define NUM_THREADS 8U
+#define NUM_HARDWARE_THREADS 8U
+
+// Number of map operations per thread:
+#define NUM_ITERATIONS 500000U
+
+// Keys are taken from [1, KEY_SPACE]:
+#define KEY_SPACE (1U << 20U)
+
+// Number of keys inserted before the measurement:
+#define NUM_PREFILL_KEYS (KEY_SPACE / 2U)
+
+// Operation mix (the rest are range scans):
+#define GET_PERCENT    80U
+#define INSERT_PERCENT 10U
+
+// Number of consecutive keys visited by a range scan:
+#define RANGE_LENGTH 32U
+
+//=========================================
+// Lazy skip list
+// NOTE: "A Simple Optimistic Skiplist
+//  Algorithm", Herlihy et al., SIROCCO'07
+//=========================================
+
+#define SKIP_MAX_LEVEL 20U
+
+// NOTE: nodes are never removed, so lock-free readers need no reclamation.
+typedef struct SKIP_NODE {
+    uint64_t key;
+    _Atomic uint64_t value;
+
+    size_t top_level;
+
+    // Node becomes visible to readers once linked on all levels:
+    _Atomic bool fully_linked;
+
+    // Protects next pointers of this node (held by inserting successors):
+    TAS_Lock lock;
+
+    struct SKIP_NODE* _Atomic next[];
+} SKIP_NODE;
+
+typedef struct {
+    // Sentinel with key 0 (smaller than any valid key), NULL stands for +inf:
+    SKIP_NODE* head;
+} SKIP_LIST;
+
+SKIP_NODE* skip_alloc_node(uint64_t key, uint64_t value, size_t top_level)
+{
+    SKIP_NODE* node = malloc(sizeof(SKIP_NODE) + (top_level + 1U) * sizeof(SKIP_NODE*));
+    if (node == NULL)
+    {
+        fprintf(stderr, "Unable to allocate skip list node\n");
+        exit(EXIT_FAILURE);
+    }
+
+    node->key       = key;
+    node->top_level = top_level;
+
+    atomic_init(&node->value, value);
+    atomic_init(&node->fully_linked, false);
+    TAS_init(&node->lock);
+
+    for (size_t level = 0U; level <= top_level; ++level)
+    {
+        atomic_init(&node->next[level], NULL);
+    }
+
+    return node;
+}
+
+void skip_init(SKIP_LIST* list)
+{
+    list->head = skip_alloc_node(0U, 0U, SKIP_MAX_LEVEL - 1U);
+    atomic_store_explicit(&list->head->fully_linked, true, memory_order_release);
+}
+
+void skip_free(SKIP_LIST* list)
+{
+    SKIP_NODE* node = list->head;
+    while (node != NULL)
+    {
+        SKIP_NODE* next = atomic_load_explicit(&node->next[0U], memory_order_relaxed);
+        free(node);
+        node = next;
+    }
+}
+
+// Geometric level distribution with p = 1/2:
+size_t skip_random_level(uint64_t random)
+{
+    return __builtin_ctzll(random | (1ULL << (SKIP_MAX_LEVEL - 1U)));
+}
+
+// Lock-free search filling predecessors and successors on every level:
+// NOTE: returns the highest level the key has been found on (or -1).
+int skip_find(SKIP_LIST* list, uint64_t key, SKIP_NODE** preds, SKIP_NODE** succs)
+{
+    int found_level = -1;
+
+    SKIP_NODE* pred = list->head;
+    for (int level = SKIP_MAX_LEVEL - 1; level >= 0; --level)
+    {
+        SKIP_NODE* curr = atomic_load_explicit(&pred->next[level], memory_order_acquire);
+        while (curr != NULL && curr->key < key)
+        {
+            pred = curr;
+            curr = atomic_load_explicit(&pred->next[level], memory_order_acquire);
+        }
+
+        if (found_level == -1 && curr != NULL && curr->key == key)
+        {
+            found_level = level;
+        }
+
+        preds[level] = pred;
+        succs[level] = curr;
+    }
+
+    return found_level;
+}
+
+bool skip_get(SKIP_LIST* list, uint64_t key, uint64_t* value)
+{
+    SKIP_NODE* pred = list->head;
+    SKIP_NODE* curr = NULL;
+    for (int level = SKIP_MAX_LEVEL - 1; level >= 0; --level)
+    {
+        curr = atomic_load_explicit(&pred->next[level], memory_order_acquire);
+        while (curr != NULL && curr->key < key)
+        {
+            pred = curr;
+            curr = atomic_load_explicit(&pred->next[level], memory_order_acquire);
+        }
+
+        if (curr != NULL && curr->key == key)
+        {
+            break;
+        }
+    }
+
+    if (curr == NULL || curr->key != key ||
+        !atomic_load_explicit(&curr->fully_linked, memory_order_acquire))
+    {
+        return false;
+    }
+
+    *value = atomic_load_explicit(&curr->value, memory_order_relaxed);
+    return true;
+}
+
+// Insert new key or update value of an existing one:
+// NOTE: returns true if the key has been inserted.
+bool skip_insert(SKIP_LIST* list, uint64_t key, uint64_t value, size_t top_level)
+{
+    SKIP_NODE* preds[SKIP_MAX_LEVEL];
+    SKIP_NODE* succs[SKIP_MAX_LEVEL];
+
+    while (true)
+    {
+        int found_level = skip_find(list, key, preds, succs);
+        if (found_level != -1)
+        {
+            SKIP_NODE* found = succs[found_level];
+
+            // Wait for concurrent insertion to complete:
+            while (!atomic_load_explicit(&found->fully_linked, memory_order_acquire))
+            {
+                // ASM instruction to ask processor cool down.
+                __asm__ volatile("pause");
+            }
+
+            atomic_store_explicit(&found->value, value, memory_order_relaxed);
+            return false;
+        }
+
+        // Lock predecessors bottom-up and validate links:
+        bool valid = true;
+        int highest_locked = -1;
+        for (int level = 0; valid && level <= (int) top_level; ++level)
+        {
+            SKIP_NODE* pred = preds[level];
+            if (level == 0 || pred != preds[level - 1])
+            {
+                TAS_acquire(&pred->lock);
+            }
+            highest_locked = level;
+
+            valid = atomic_load_explicit(&pred->next[level], memory_order_acquire) == succs[level];
+        }
+
+        if (valid)
+        {
+            SKIP_NODE* node = skip_alloc_node(key, value, top_level);
+
+            for (size_t level = 0U; level <= top_level; ++level)
+            {
+                atomic_store_explicit(&node->next[level], succs[level], memory_order_relaxed);
+            }
+
+            for (size_t level = 0U; level <= top_level; ++level)
+            {
+                atomic_store_explicit(&preds[level]->next[level], node, memory_order_release);
+            }
+
+            atomic_store_explicit(&node->fully_linked, true, memory_order_release);
+        }
+
+        // Unlock every distinct predecessor:
+        for (int level = 0; level <= highest_locked; ++level)
+        {
+            if (level == 0 || preds[level] != preds[level - 1])
+            {
+                TAS_release(&preds[level]->lock);
+            }
+        }
+
+        if (valid)
+        {
+            return true;
+        }
+    }
+}
+
+// Lock-free scan of up to RANGE_LENGTH keys starting from lo:
+// NOTE: weakly consistent, keys inserted concurrently may or may not be seen.
+size_t skip_range_scan(SKIP_LIST* list, uint64_t lo, uint64_t* sum)
+{
+    SKIP_NODE* pred = list->head;
+    for (int level = SKIP_MAX_LEVEL - 1; level >= 0; --level)
+    {
+        SKIP_NODE* curr = atomic_load_explicit(&pred->next[level], memory_order_acquire);
+        while (curr != NULL && curr->key < lo)
+        {
+            pred = curr;
+            curr = atomic_load_explicit(&pred->next[level], memory_order_acquire);
+        }
+    }
+
+    size_t num_visited = 0U;
+    SKIP_NODE* curr = atomic_load_explicit(&pred->next[0U], memory_order_acquire);
+    while (curr != NULL && num_visited < RANGE_LENGTH)
+    {
+        if (atomic_load_explicit(&curr->fully_linked, memory_order_acquire))
+        {
+            *sum += atomic_load_explicit(&curr->value, memory_order_relaxed);
+            num_visited += 1U;
+        }
+
+        curr = atomic_load_explicit(&curr->next[0U], memory_order_acquire);
+    }
+
+    return num_visited;
+}
+
+//=========================================
+// Baseline: AVL tree under a single mutex
+//=========================================
+
+typedef struct AVL_NODE {
+    struct AVL_NODE* left;
+    struct AVL_NODE* right;
+
+    uint64_t key;
+    uint64_t value;
+
+    int height;
+} AVL_NODE;
+
+typedef struct {
+    pthread_mutex_t mutex;
+    AVL_NODE* root;
+} AVL_TREE;
+
+static inline int avl_height(AVL_NODE* node)
+{
+    return (node == NULL)? 0 : node->height;
+}
+
+static inline void avl_update_height(AVL_NODE* node)
+{
+    int left  = avl_height(node->left);
+    int right = avl_height(node->right);
+
+    node->height = 1 + ((left > right)? left : right);
+}
+
+AVL_NODE* avl_rotate_right(AVL_NODE* node)
+{
+    AVL_NODE* pivot = node->left;
+
+    node->left   = pivot->right;
+    pivot->right = node;
+
+    avl_update_height(node);
+    avl_update_height(pivot);
+
+    return pivot;
+}
+
+AVL_NODE* avl_rotate_left(AVL_NODE* node)
+{
+    AVL_NODE* pivot = node->right;
+
+    node->right = pivot->left;
+    pivot->left = node;
+
+    avl_update_height(node);
+    avl_update_height(pivot);
+
+    return pivot;
+}
+
+AVL_NODE* avl_balance(AVL_NODE* node)
+{
+    avl_update_height(node);
+
+    int balance = avl_height(node->left) - avl_height(node->right);
+    if (balance > 1)
+    {
+        if (avl_height(node->left->left) < avl_height(node->left->right))
+        {
+            node->left = avl_rotate_left(node->left);
+        }
+
+        return avl_rotate_right(node);
+    }
+
+    if (balance < -1)
+    {
+        if (avl_height(node->right->right) < avl_height(node->right->left))
+        {
+            node->right = avl_rotate_right(node->right);
+        }
+
+        return avl_rotate_left(node);
+    }
+
+    return node;
+}
+
+AVL_NODE* avl_insert_node(AVL_NODE* node, uint64_t key, uint64_t value, bool* inserted)
+{
+    if (node == NULL)
+    {
+        AVL_NODE* new_node = malloc(sizeof(AVL_NODE));
+        if (new_node == NULL)
+        {
+            fprintf(stderr, "Unable to allocate tree node\n");
+            exit(EXIT_FAILURE);
+        }
+
+        *new_node = (AVL_NODE) {.left = NULL, .right = NULL, .key = key, .value = value, .height = 1};
+
+        *inserted = true;
+        return new_node;
+    }
+
+    if (key < node->key)
+    {
+        node->left = avl_insert_node(node->left, key, value, inserted);
+    }
+    else if (key > node->key)
+    {
+        node->right = avl_insert_node(node->right, key, value, inserted);
+    }
+    else
+    {
+        node->value = value;
+        return node;
+    }
+
+    return avl_balance(node);
+}
+
+void avl_free_node(AVL_NODE* node)
+{
+    if (node != NULL)
+    {
+        avl_free_node(node->left);
+        avl_free_node(node->right);
+        free(node);
+    }
+}
+
+// In-order visit of keys not less than lo:
+void avl_scan_node(AVL_NODE* node, uint64_t lo, size_t* num_visited, uint64_t* sum)
+{
+    if (node == NULL || *num_visited == RANGE_LENGTH)
+    {
+        return;
+    }
+
+    if (lo < node->key)
+    {
+        avl_scan_node(node->left, lo, num_visited, sum);
+    }
+
+    if (node->key >= lo && *num_visited < RANGE_LENGTH)
+    {
+        *sum += node->value;
+        *num_visited += 1U;
+    }
+
+    avl_scan_node(node->right, lo, num_visited, sum);
+}
+
+void avl_init(AVL_TREE* tree)
+{
+    pthread_mutex_init(&tree->mutex, NULL);
+    tree->root = NULL;
+}
+
+void avl_free(AVL_TREE* tree)
+{
+    avl_free_node(tree->root);
+    pthread_mutex_destroy(&tree->mutex);
+}
+
+bool avl_get(AVL_TREE* tree, uint64_t key, uint64_t* value)
+{
+    pthread_mutex_lock(&tree->mutex);
+
+    AVL_NODE* node = tree->root;
+    while (node != NULL && node->key != key)
+    {
+        node = (key < node->key)? node->left : node->right;
+    }
+
+    if (node != NULL)
+    {
+        *value = node->value;
+    }
+
+    pthread_mutex_unlock(&tree->mutex);
+
+    return node != NULL;
+}
+
+bool avl_insert(AVL_TREE* tree, uint64_t key, uint64_t value)
+{
+    bool inserted = false;
+
+    pthread_mutex_lock(&tree->mutex);
+    tree->root = avl_insert_node(tree->root, key, value, &inserted);
+    pthread_mutex_unlock(&tree->mutex);
+
+    return inserted;
+}
+
+size_t avl_range_scan(AVL_TREE* tree, uint64_t lo, uint64_t* sum)
+{
+    size_t num_visited = 0U;
+
+    pthread_mutex_lock(&tree->mutex);
+    avl_scan_node(tree->root, lo, &num_visited, sum);
+    pthread_mutex_unlock(&tree->mutex);
+
+    return num_visited;
+}
+
+//==================
+// Thread execution
+//==================
+
+typedef enum {
+    MAP_SKIP_LIST = 0,
+    MAP_AVL_TREE  = 1
+} MAP_KIND;
+
+const char* MAP_KIND_NAMES[] = {
+    [MAP_SKIP_LIST] = "skip list",
+    [MAP_AVL_TREE]  = "mutex+AVL"
+};
+
+// Per-thread counters are updated on every operation, so keep them on separate cache lines:
+typedef struct {
+    _Alignas(WORKER_POOL_ALIGNMENT) size_t thread_i;
+    MAP_KIND kind;
+
+    SKIP_LIST* skip_list;
+    AVL_TREE* avl_tree;
+
+    // Time spent in every kind of operation:
+    double get_ns;
+    double insert_ns;
+    double scan_ns;
+
+    uint64_t num_gets;
+    uint64_t num_inserts;
+    uint64_t num_scans;
+
+    uint64_t checksum;
+} THREAD_ARGS;
+
+static inline uint64_t xorshift(uint64_t* state)
+{
+    uint64_t x = *state;
+    x ^= x << 13U;
+    x ^= x >> 7U;
+    x ^= x << 17U;
+    *state = x;
+
+    return x;
+}
+
+void* thread_func(void* thread_args)
+{
+    THREAD_ARGS* args = (THREAD_ARGS*) thread_args;
+
+    uint64_t rng_state = 0x9E3779B97F4A7C15ULL * (args->thread_i + 1U);
+
+    for (size_t i = 0U; i < NUM_ITERATIONS; ++i)
+    {
+        uint64_t key = 1U + xorshift(&rng_state) % KEY_SPACE;
+        uint32_t op  = xorshift(&rng_state) % 100U;
+
+        double start_ns = worker_pool_time_ns();
+
+        if (op < GET_PERCENT)
+        {
+            uint64_t value = 0U;
+            if (args->kind == MAP_SKIP_LIST)
+            {
+                skip_get(args->skip_list, key, &value);
+            }
+            else
+            {
+                avl_get(args->avl_tree, key, &value);
+            }
+
+            args->checksum += value;
+            args->get_ns   += worker_pool_time_ns() - start_ns;
+            args->num_gets += 1U;
+        }
+        else if (op < GET_PERCENT + INSERT_PERCENT)
+        {
+            if (args->kind == MAP_SKIP_LIST)
+            {
+                skip_insert(args->skip_list, key, i, skip_random_level(xorshift(&rng_state)));
+            }
+            else
+            {
+                avl_insert(args->avl_tree, key, i);
+            }
+
+            args->insert_ns   += worker_pool_time_ns() - start_ns;
+            args->num_inserts += 1U;
+        }
+        else
+        {
+            if (args->kind == MAP_SKIP_LIST)
+            {
+                skip_range_scan(args->skip_list, key, &args->checksum);
+            }
+            else
+            {
+                avl_range_scan(args->avl_tree, key, &args->checksum);
+            }
+
+            args->scan_ns   += worker_pool_time_ns() - start_ns;
+            args->num_scans += 1U;
+        }
+    }
+
+    return NULL;
+}
+
+//==================
+// Thread benchmark
+//==================
+
+void run_benchmark(WORKER_POOL* pool, MAP_KIND kind, size_t num_threads)
+{
+    SKIP_LIST skip_list;
+    skip_init(&skip_list);
+
+    AVL_TREE avl_tree;
+    avl_init(&avl_tree);
+
+    // Pre-fill with the same keys for both maps:
+    uint64_t rng_state = 0x2545F4914F6CDD1DULL;
+    for (size_t i = 0U; i < NUM_PREFILL_KEYS; ++i)
+    {
+        uint64_t key = 1U + xorshift(&rng_state) % KEY_SPACE;
+
+        if (kind == MAP_SKIP_LIST)
+        {
+            skip_insert(&skip_list, key, key, skip_random_level(xorshift(&rng_state)));
+        }
+        else
+        {
+            avl_insert(&avl_tree, key, key);
+        }
+    }
+
+    // Initialize thread data:
+    THREAD_ARGS args[NUM_THREADS];
+    for (size_t i = 0U; i < num_threads; ++i)
+    {
+        args[i] = (THREAD_ARGS) {
+            .thread_i  = i,
+            .kind      = kind,
+            .skip_list = &skip_list,
+            .avl_tree  = &avl_tree
+        };
+    }
+
+    double start_ns = worker_pool_time_ns();
+
+    // Submit work to pool workers:
+    for (size_t i = 0U; i < num_threads; ++i)
+    {
+        worker_pool_submit(pool, i, thread_func, &args[i]);
+    }
+
+    // Wait for all workers to finish execution:
+    worker_pool_wait(pool);
+
+    double elapsed_ns = worker_pool_time_ns() - start_ns;
+
+    // Sum up statistics:
+    THREAD_ARGS total = {0};
+    for (size_t i = 0U; i < num_threads; ++i)
+    {
+        total.get_ns      += args[i].get_ns;
+        total.insert_ns   += args[i].insert_ns;
+        total.scan_ns     += args[i].scan_ns;
+        total.num_gets    += args[i].num_gets;
+        total.num_inserts += args[i].num_inserts;
+        total.num_scans   += args[i].num_scans;
+        total.checksum    += args[i].checksum;
+    }
+
+    printf("%-10s %7zu %9.2f Mops/s %10.1f ns %10.1f ns %10.1f ns %22lu\n",
+        MAP_KIND_NAMES[kind],
+        num_threads,
+        (double) num_threads * NUM_ITERATIONS / elapsed_ns * 1e3,
+        total.get_ns / total.num_gets,
+        total.insert_ns / total.num_inserts,
+        total.scan_ns / total.num_scans,
+        total.checksum);
+
+    skip_free(&skip_list);
+    avl_free(&avl_tree);
+}
+
+int main()
+{
+    // Start persistent worker pool:
+    WORKER_POOL pool;
+    worker_pool_init(&pool, NUM_THREADS, NUM_HARDWARE_THREADS);
+
+    printf("%-10s %7s %16s %13s %13s %13s %22s\n",
+        "Map", "Threads", "Throughput", "Get", "Insert", "Range scan", "Checksum");
+
+    // Look for the crossover point:
+    for (size_t num_threads = 1U; num_threads <= NUM_THREADS; num_threads *= 2U)
+    {
+        run_benchmark(&pool, MAP_AVL_TREE, num_threads);
+        run_benchmark(&pool, MAP_SKIP_LIST, num_threads);
+    }
+
+    // Stop worker threads:
+    worker_pool_destroy(&pool);
+
+    return EXIT_SUCCESS;
+}
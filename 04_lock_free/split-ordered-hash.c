@@ -0,0 +1,913 @@
+// No copyright. Vladislav Alenik, 2024
+
+// Feature test macro:
+#define _GNU_SOURCE
+
+#include "reclamation.h"
+
+// Threads:
+#include <pthread.h>
+// Persistent worker pool:
+#include "../01_pthreads_sync/worker-pool.h"
+
+//======================
+// Benchmark parameters
+//======================
+
+#define NUM_THREADS 8U
+#define NUM_HARDWARE_THREADS 8U
+
+// Number of map operations per thread:
+#define NUM_ITERATIONS 2000000U
+
+// Keys are taken from [0, KEY_SPACE):
+#define KEY_SPACE (1U << 20U)
+
+// Operation mix (the rest are removals):
+#define LOOKUP_PERCENT 80U
+#define INSERT_PERCENT 15U
+
+// Table starts tiny and has to grow under load:
+#define INITIAL_BUCKETS 2U
+
+// Average number of keys per bucket that triggers doubling:
+#define MAX_LOAD_FACTOR 2U
+
+// Every N-th lookup is timed:
+#define LATENCY_SAMPLE_RATE 4U
+
+//=======================================
+// Split-ordered list
+// NOTE: "Split-Ordered Lists: Lock-Free
+//  Extensible Hash Tables",
+//  Shalev and Shavit, JACM'06
+//=======================================
+
+// Bucket directory is segmented, so it grows without copying:
+#define SEGMENT_SIZE 1024U
+#define MAX_SEGMENTS 1024U
+#define MAX_BUCKETS (SEGMENT_SIZE * MAX_SEGMENTS)
+
+// Lowest bit of the next pointer marks the node as logically deleted:
+#define MARK_BIT 1U
+
+typedef struct NODE {
+    // Bit-reversed hash (odd for regular nodes, even for bucket dummies):
+    uint64_t so_key;
+
+    uint32_t key;
+    _Atomic uint64_t value;
+
+    _Atomic uintptr_t next;
+} NODE;
+
+typedef struct {
+    NODE* _Atomic* _Atomic segments[MAX_SEGMENTS];
+
+    // Number of buckets in use (power of two):
+    _Alignas(RECLAIM_ALIGNMENT) _Atomic size_t size;
+    _Alignas(RECLAIM_ALIGNMENT) _Atomic size_t count;
+
+    EBR_DOMAIN* ebr;
+} SO_TABLE;
+
+static inline NODE* so_unmark(uintptr_t ptr)
+{
+    return (NODE*) (ptr & ~(uintptr_t) MARK_BIT);
+}
+
+static inline bool so_is_marked(uintptr_t ptr)
+{
+    return (ptr & MARK_BIT) != 0U;
+}
+
+static inline uint64_t reverse_bits(uint64_t x)
+{
+    x = ((x >>  1U) & 0x5555555555555555ULL) | ((x & 0x5555555555555555ULL) <<  1U);
+    x = ((x >>  2U) & 0x3333333333333333ULL) | ((x & 0x3333333333333333ULL) <<  2U);
+    x = ((x >>  4U) & 0x0F0F0F0F0F0F0F0FULL) | ((x & 0x0F0F0F0F0F0F0F0FULL) <<  4U);
+    x = ((x >>  8U) & 0x00FF00FF00FF00FFULL) | ((x & 0x00FF00FF00FF00FFULL) <<  8U);
+    x = ((x >> 16U) & 0x0000FFFF0000FFFFULL) | ((x & 0x0000FFFF0000FFFFULL) << 16U);
+
+    return (x >> 32U) | (x << 32U);
+}
+
+// Bijective mixing (MurmurHash3 finalizer), so distinct keys never share so_key:
+static inline uint32_t hash_key(uint32_t key)
+{
+    key ^= key >> 16U;
+    key *= 0x85EBCA6BU;
+    key ^= key >> 13U;
+    key *= 0xC2B2AE35U;
+    key ^= key >> 16U;
+
+    return key;
+}
+
+static inline uint64_t so_regular_key(uint32_t hash)
+{
+    return reverse_bits((uint64_t) hash | (1ULL << 63U));
+}
+
+static inline uint64_t so_dummy_key(size_t bucket)
+{
+    return reverse_bits(bucket);
+}
+
+// Bucket with the most significant bit cleared:
+static inline size_t so_parent_bucket(size_t bucket)
+{
+    return bucket & ~(1ULL << (63U - __builtin_clzll(bucket)));
+}
+
+NODE* so_alloc_node(uint64_t so_key, uint32_t key, uint64_t value)
+{
+    NODE* node = malloc(sizeof(NODE));
+    if (node == NULL)
+    {
+        fprintf(stderr, "Unable to allocate list node\n");
+        exit(EXIT_FAILURE);
+    }
+
+    node->so_key = so_key;
+    node->key    = key;
+    atomic_init(&node->value, value);
+    atomic_init(&node->next, (uintptr_t) NULL);
+
+    return node;
+}
+
+NODE* so_get_bucket(SO_TABLE* table, size_t bucket)
+{
+    NODE* _Atomic* segment = atomic_load_explicit(&table->segments[bucket / SEGMENT_SIZE], memory_order_acquire);
+    if (segment == NULL)
+    {
+        return NULL;
+    }
+
+    return atomic_load_explicit(&segment[bucket % SEGMENT_SIZE], memory_order_acquire);
+}
+
+void so_set_bucket(SO_TABLE* table, size_t bucket, NODE* dummy)
+{
+    NODE* _Atomic* _Atomic* slot = &table->segments[bucket / SEGMENT_SIZE];
+
+    NODE* _Atomic* segment = atomic_load_explicit(slot, memory_order_acquire);
+    if (segment == NULL)
+    {
+        NODE* _Atomic* new_segment = calloc(SEGMENT_SIZE, sizeof(NODE*));
+        if (new_segment == NULL)
+        {
+            fprintf(stderr, "Unable to allocate bucket segment\n");
+            exit(EXIT_FAILURE);
+        }
+
+        if (atomic_compare_exchange_strong_explicit(slot, &segment, new_segment,
+            memory_order_acq_rel, memory_order_acquire))
+        {
+            segment = new_segment;
+        }
+        else
+        {
+            // Another thread has installed the segment first:
+            free(new_segment);
+        }
+    }
+
+    atomic_store_explicit(&segment[bucket % SEGMENT_SIZE], dummy, memory_order_release);
+}
+
+// Find position of so_key in the list starting at head (unlinks marked nodes on the way):
+// NOTE: called inside EBR critical section.
+bool so_list_find(SO_TABLE* table, size_t thread_i, NODE* head, uint64_t so_key,
+                  _Atomic uintptr_t** prev_out, NODE** curr_out)
+{
+retry:
+    _Atomic uintptr_t* prev = &head->next;
+    NODE* curr = so_unmark(atomic_load_explicit(prev, memory_order_acquire));
+
+    while (curr != NULL)
+    {
+        uintptr_t next = atomic_load_explicit(&curr->next, memory_order_acquire);
+
+        if (so_is_marked(next))
+        {
+            // Help to unlink logically deleted node:
+            uintptr_t expected = (uintptr_t) curr;
+            if (!atomic_compare_exchange_strong_explicit(prev, &expected, (uintptr_t) so_unmark(next),
+                memory_order_acq_rel, memory_order_relaxed))
+            {
+                goto retry;
+            }
+
+            ebr_retire(table->ebr, thread_i, curr);
+
+            curr = so_unmark(next);
+            continue;
+        }
+
+        if (curr->so_key >= so_key)
+        {
+            break;
+        }
+
+        prev = &curr->next;
+        curr = so_unmark(next);
+    }
+
+    *prev_out = prev;
+    *curr_out = curr;
+
+    return curr != NULL && curr->so_key == so_key;
+}
+
+// Link node into the list, or return already present node with the same so_key:
+NODE* so_list_insert(SO_TABLE* table, size_t thread_i, NODE* head, NODE* node)
+{
+    while (true)
+    {
+        _Atomic uintptr_t* prev;
+        NODE* curr;
+        if (so_list_find(table, thread_i, head, node->so_key, &prev, &curr))
+        {
+            return curr;
+        }
+
+        atomic_store_explicit(&node->next, (uintptr_t) curr, memory_order_relaxed);
+
+        uintptr_t expected = (uintptr_t) curr;
+        if (atomic_compare_exchange_strong_explicit(prev, &expected, (uintptr_t) node,
+            memory_order_release, memory_order_relaxed))
+        {
+            return node;
+        }
+    }
+}
+
+NODE* so_initialize_bucket(SO_TABLE* table, size_t thread_i, size_t bucket)
+{
+    size_t parent = so_parent_bucket(bucket);
+
+    NODE* parent_dummy = so_get_bucket(table, parent);
+    if (parent_dummy == NULL)
+    {
+        parent_dummy = so_initialize_bucket(table, thread_i, parent);
+    }
+
+    NODE* dummy = so_alloc_node(so_dummy_key(bucket), 0U, 0U);
+
+    NODE* linked = so_list_insert(table, thread_i, parent_dummy, dummy);
+    if (linked != dummy)
+    {
+        // Dummy has been inserted concurrently (and never published ours):
+        free(dummy);
+    }
+
+    so_set_bucket(table, bucket, linked);
+
+    return linked;
+}
+
+NODE* so_bucket_for_update(SO_TABLE* table, size_t thread_i, uint32_t hash)
+{
+    size_t bucket = hash & (atomic_load_explicit(&table->size, memory_order_acquire) - 1U);
+
+    NODE* dummy = so_get_bucket(table, bucket);
+    if (dummy == NULL)
+    {
+        dummy = so_initialize_bucket(table, thread_i, bucket);
+    }
+
+    return dummy;
+}
+
+void so_init(SO_TABLE* table, EBR_DOMAIN* ebr)
+{
+    for (size_t i = 0U; i < MAX_SEGMENTS; ++i)
+    {
+        atomic_init(&table->segments[i], NULL);
+    }
+
+    atomic_init(&table->size, INITIAL_BUCKETS);
+    atomic_init(&table->count, 0U);
+
+    table->ebr = ebr;
+
+    // Bucket#0 is the head of the whole list:
+    so_set_bucket(table, 0U, so_alloc_node(so_dummy_key(0U), 0U, 0U));
+}
+
+// NOTE: all threads are expected to be quiescent.
+void so_free(SO_TABLE* table)
+{
+    NODE* node = so_get_bucket(table, 0U);
+    while (node != NULL)
+    {
+        NODE* next = so_unmark(atomic_load_explicit(&node->next, memory_order_relaxed));
+        free(node);
+        node = next;
+    }
+
+    for (size_t i = 0U; i < MAX_SEGMENTS; ++i)
+    {
+        free(atomic_load_explicit(&table->segments[i], memory_order_relaxed));
+    }
+}
+
+// Read-only lookup: lock-free (no locks, no writes to the table).
+// NOTE: concurrent inserts may keep extending the traversal, so it is not wait-free.
+bool so_lookup(SO_TABLE* table, size_t thread_i, uint32_t key, uint64_t* value)
+{
+    uint32_t hash = hash_key(key);
+    uint64_t so_key = so_regular_key(hash);
+
+    ebr_enter(table->ebr, thread_i);
+
+    // Uninitialized bucket is a sublist of its parent:
+    size_t bucket = hash & (atomic_load_explicit(&table->size, memory_order_acquire) - 1U);
+
+    NODE* curr = so_get_bucket(table, bucket);
+    while (curr == NULL)
+    {
+        bucket = so_parent_bucket(bucket);
+        curr = so_get_bucket(table, bucket);
+    }
+
+    while (curr != NULL && curr->so_key < so_key)
+    {
+        curr = so_unmark(atomic_load_explicit(&curr->next, memory_order_acquire));
+    }
+
+    bool found = curr != NULL && curr->so_key == so_key &&
+        !so_is_marked(atomic_load_explicit(&curr->next, memory_order_acquire));
+    if (found)
+    {
+        *value = atomic_load_explicit(&curr->value, memory_order_relaxed);
+    }
+
+    ebr_exit(table->ebr, thread_i);
+
+    return found;
+}
+
+bool so_insert(SO_TABLE* table, size_t thread_i, uint32_t key, uint64_t value)
+{
+    uint32_t hash = hash_key(key);
+    NODE* node = so_alloc_node(so_regular_key(hash), key, value);
+
+    ebr_enter(table->ebr, thread_i);
+
+    NODE* linked = so_list_insert(table, thread_i, so_bucket_for_update(table, thread_i, hash), node);
+
+    ebr_exit(table->ebr, thread_i);
+
+    if (linked != node)
+    {
+        // Key is already present:
+        free(node);
+        return false;
+    }
+
+    // Incremental resize: doubling the size only makes new buckets reachable,
+    // they are split off their parents lazily on first access.
+    size_t count = atomic_fetch_add_explicit(&table->count, 1U, memory_order_relaxed) + 1U;
+    size_t size  = atomic_load_explicit(&table->size, memory_order_relaxed);
+    if (count / size > MAX_LOAD_FACTOR && 2U * size <= MAX_BUCKETS)
+    {
+        atomic_compare_exchange_strong_explicit(&table->size, &size, 2U * size,
+            memory_order_release, memory_order_relaxed);
+    }
+
+    return true;
+}
+
+bool so_remove(SO_TABLE* table, size_t thread_i, uint32_t key)
+{
+    uint32_t hash = hash_key(key);
+    uint64_t so_key = so_regular_key(hash);
+
+    ebr_enter(table->ebr, thread_i);
+
+    NODE* head = so_bucket_for_update(table, thread_i, hash);
+
+    bool removed = false;
+    while (true)
+    {
+        _Atomic uintptr_t* prev;
+        NODE* curr;
+        if (!so_list_find(table, thread_i, head, so_key, &prev, &curr))
+        {
+            break;
+        }
+
+        // Logical deletion:
+        uintptr_t next = atomic_load_explicit(&curr->next, memory_order_acquire);
+        if (so_is_marked(next) ||
+            !atomic_compare_exchange_strong_explicit(&curr->next, &next, next | MARK_BIT,
+                memory_order_acq_rel, memory_order_relaxed))
+        {
+            continue;
+        }
+
+        removed = true;
+
+        // Physical deletion (or leave it to the next traversal):
+        uintptr_t expected = (uintptr_t) curr;
+        if (atomic_compare_exchange_strong_explicit(prev, &expected, next,
+            memory_order_acq_rel, memory_order_relaxed))
+        {
+            ebr_retire(table->ebr, thread_i, curr);
+        }
+        else
+        {
+            so_list_find(table, thread_i, head, so_key, &prev, &curr);
+        }
+
+        break;
+    }
+
+    ebr_exit(table->ebr, thread_i);
+
+    if (removed)
+    {
+        atomic_fetch_sub_explicit(&table->count, 1U, memory_order_relaxed);
+    }
+
+    return removed;
+}
+
+//=============================================
+// Baseline: rwlock with stop-the-world rehash
+//=============================================
+
+typedef struct RW_NODE {
+    struct RW_NODE* next;
+    uint32_t key;
+    uint64_t value;
+} RW_NODE;
+
+typedef struct {
+    pthread_rwlock_t lock;
+
+    RW_NODE** buckets;
+    size_t size;
+    size_t count;
+
+    // Number of rehashes and the longest one:
+    size_t num_rehashes;
+    double max_rehash_ns;
+} RW_TABLE;
+
+RW_NODE** rw_alloc_buckets(size_t size)
+{
+    RW_NODE** buckets = calloc(size, sizeof(RW_NODE*));
+    if (buckets == NULL)
+    {
+        fprintf(stderr, "Unable to allocate %zu buckets\n", size);
+        exit(EXIT_FAILURE);
+    }
+
+    return buckets;
+}
+
+void rw_init(RW_TABLE* table)
+{
+    pthread_rwlock_init(&table->lock, NULL);
+
+    table->buckets = rw_alloc_buckets(INITIAL_BUCKETS);
+    table->size    = INITIAL_BUCKETS;
+    table->count   = 0U;
+
+    table->num_rehashes  = 0U;
+    table->max_rehash_ns = 0.0;
+}
+
+void rw_free(RW_TABLE* table)
+{
+    for (size_t i = 0U; i < table->size; ++i)
+    {
+        RW_NODE* node = table->buckets[i];
+        while (node != NULL)
+        {
+            RW_NODE* next = node->next;
+            free(node);
+            node = next;
+        }
+    }
+
+    free(table->buckets);
+    pthread_rwlock_destroy(&table->lock);
+}
+
+// NOTE: called under write lock, so every reader waits for the whole rehash.
+void rw_rehash(RW_TABLE* table)
+{
+    double start_ns = worker_pool_time_ns();
+
+    size_t new_size = 2U * table->size;
+    RW_NODE** new_buckets = rw_alloc_buckets(new_size);
+
+    for (size_t i = 0U; i < table->size; ++i)
+    {
+        RW_NODE* node = table->buckets[i];
+        while (node != NULL)
+        {
+            RW_NODE* next = node->next;
+
+            size_t bucket = hash_key(node->key) & (new_size - 1U);
+            node->next = new_buckets[bucket];
+            new_buckets[bucket] = node;
+
+            node = next;
+        }
+    }
+
+    free(table->buckets);
+    table->buckets = new_buckets;
+    table->size    = new_size;
+
+    double rehash_ns = worker_pool_time_ns() - start_ns;
+
+    table->num_rehashes += 1U;
+    if (rehash_ns > table->max_rehash_ns)
+    {
+        table->max_rehash_ns = rehash_ns;
+    }
+}
+
+bool rw_lookup(RW_TABLE* table, uint32_t key, uint64_t* value)
+{
+    pthread_rwlock_rdlock(&table->lock);
+
+    RW_NODE* node = table->buckets[hash_key(key) & (table->size - 1U)];
+    while (node != NULL && node->key != key)
+    {
+        node = node->next;
+    }
+
+    if (node != NULL)
+    {
+        *value = node->value;
+    }
+
+    pthread_rwlock_unlock(&table->lock);
+
+    return node != NULL;
+}
+
+bool rw_insert(RW_TABLE* table, uint32_t key, uint64_t value)
+{
+    RW_NODE* new_node = malloc(sizeof(RW_NODE));
+    if (new_node == NULL)
+    {
+        fprintf(stderr, "Unable to allocate list node\n");
+        exit(EXIT_FAILURE);
+    }
+
+    new_node->key   = key;
+    new_node->value = value;
+
+    pthread_rwlock_wrlock(&table->lock);
+
+    RW_NODE** head = &table->buckets[hash_key(key) & (table->size - 1U)];
+    for (RW_NODE* node = *head; node != NULL; node = node->next)
+    {
+        if (node->key == key)
+        {
+            pthread_rwlock_unlock(&table->lock);
+
+            free(new_node);
+            return false;
+        }
+    }
+
+    new_node->next = *head;
+    *head = new_node;
+
+    table->count += 1U;
+    if (table->count / table->size > MAX_LOAD_FACTOR && 2U * table->size <= MAX_BUCKETS)
+    {
+        rw_rehash(table);
+    }
+
+    pthread_rwlock_unlock(&table->lock);
+
+    return true;
+}
+
+bool rw_remove(RW_TABLE* table, uint32_t key)
+{
+    pthread_rwlock_wrlock(&table->lock);
+
+    RW_NODE** link = &table->buckets[hash_key(key) & (table->size - 1U)];
+    while (*link != NULL && (*link)->key != key)
+    {
+        link = &(*link)->next;
+    }
+
+    RW_NODE* node = *link;
+    if (node != NULL)
+    {
+        *link = node->next;
+        table->count -= 1U;
+    }
+
+    pthread_rwlock_unlock(&table->lock);
+
+    free(node);
+
+    return node != NULL;
+}
+
+//==========================
+// Lookup latency histogram
+//==========================
+
+// Log-linear bins: 8 sub-bins per power of two (12.5% resolution):
+#define LATENCY_SUB_BITS 3U
+#define LATENCY_NUM_BINS (64U << LATENCY_SUB_BITS)
+
+typedef struct {
+    uint64_t bins[LATENCY_NUM_BINS];
+    uint64_t num_samples;
+    uint64_t max_ns;
+} LATENCY_HIST;
+
+static inline size_t latency_bin(uint64_t ns)
+{
+    if (ns < (1U << LATENCY_SUB_BITS))
+    {
+        return ns;
+    }
+
+    size_t log = 63U - __builtin_clzll(ns);
+    size_t sub = (ns >> (log - LATENCY_SUB_BITS)) & ((1U << LATENCY_SUB_BITS) - 1U);
+
+    return ((log - LATENCY_SUB_BITS + 1U) << LATENCY_SUB_BITS) + sub;
+}
+
+// Lower bound of bin range:
+static inline uint64_t latency_bin_ns(size_t bin)
+{
+    if (bin < (1U << LATENCY_SUB_BITS))
+    {
+        return bin;
+    }
+
+    size_t log = (bin >> LATENCY_SUB_BITS) + LATENCY_SUB_BITS - 1U;
+    size_t sub = bin & ((1U << LATENCY_SUB_BITS) - 1U);
+
+    return (1ULL << log) | ((uint64_t) sub << (log - LATENCY_SUB_BITS));
+}
+
+void latency_record(LATENCY_HIST* hist, uint64_t ns)
+{
+    hist->bins[latency_bin(ns)] += 1U;
+    hist->num_samples += 1U;
+
+    if (ns > hist->max_ns)
+    {
+        hist->max_ns = ns;
+    }
+}
+
+uint64_t latency_percentile(const LATENCY_HIST* hist, double percentile)
+{
+    uint64_t threshold = (uint64_t) (percentile / 100.0 * hist->num_samples);
+
+    uint64_t seen = 0U;
+    for (size_t bin = 0U; bin < LATENCY_NUM_BINS; ++bin)
+    {
+        seen += hist->bins[bin];
+        if (seen > threshold)
+        {
+            return latency_bin_ns(bin);
+        }
+    }
+
+    return hist->max_ns;
+}
+
+//==================
+// Thread execution
+//==================
+
+typedef enum {
+    TABLE_SPLIT_ORDERED = 0,
+    TABLE_RWLOCK_REHASH = 1
+} TABLE_KIND;
+
+const char* TABLE_KIND_NAMES[] = {
+    [TABLE_SPLIT_ORDERED] = "split-ordered",
+    [TABLE_RWLOCK_REHASH] = "rwlock+rehash"
+};
+
+// Per-thread counters are updated on every lookup, so keep them on separate cache lines:
+typedef struct {
+    _Alignas(WORKER_POOL_ALIGNMENT) size_t thread_i;
+    TABLE_KIND kind;
+
+    SO_TABLE* so_table;
+    RW_TABLE* rw_table;
+
+    LATENCY_HIST lookup_latency;
+    uint64_t num_lookups;
+    uint64_t num_hits;
+    uint64_t checksum;
+} THREAD_ARGS;
+
+static inline uint64_t xorshift(uint64_t* state)
+{
+    uint64_t x = *state;
+    x ^= x << 13U;
+    x ^= x >> 7U;
+    x ^= x << 17U;
+    *state = x;
+
+    return x;
+}
+
+void* thread_func(void* thread_args)
+{
+    THREAD_ARGS* args = (THREAD_ARGS*) thread_args;
+
+    uint64_t rng_state = 0x9E3779B97F4A7C15ULL * (args->thread_i + 1U);
+
+    for (size_t i = 0U; i < NUM_ITERATIONS; ++i)
+    {
+        uint32_t key = xorshift(&rng_state) % KEY_SPACE;
+        uint32_t op  = xorshift(&rng_state) % 100U;
+
+        if (op < LOOKUP_PERCENT)
+        {
+            bool timed = (i % LATENCY_SAMPLE_RATE == 0U);
+            double start_ns = timed? worker_pool_time_ns() : 0.0;
+
+            uint64_t value = 0U;
+            bool found = (args->kind == TABLE_SPLIT_ORDERED)?
+                so_lookup(args->so_table, args->thread_i, key, &value) :
+                rw_lookup(args->rw_table, key, &value);
+
+            if (timed)
+            {
+                latency_record(&args->lookup_latency, worker_pool_time_ns() - start_ns);
+            }
+
+            args->num_lookups += 1U;
+            args->num_hits    += found;
+            args->checksum += value;
+        }
+        else if (op < LOOKUP_PERCENT + INSERT_PERCENT)
+        {
+            if (args->kind == TABLE_SPLIT_ORDERED)
+            {
+                so_insert(args->so_table, args->thread_i, key, i);
+            }
+            else
+            {
+                rw_insert(args->rw_table, key, i);
+            }
+        }
+        else
+        {
+            if (args->kind == TABLE_SPLIT_ORDERED)
+            {
+                so_remove(args->so_table, args->thread_i, key);
+            }
+            else
+            {
+                rw_remove(args->rw_table, key);
+            }
+        }
+    }
+
+    return NULL;
+}
+
+//==================
+// Thread benchmark
+//==================
+
+void run_benchmark(WORKER_POOL* pool, TABLE_KIND kind)
+{
+    EBR_DOMAIN ebr_domain;
+    ebr_init(&ebr_domain, NUM_THREADS, free);
+
+    SO_TABLE* so_table = malloc(sizeof(SO_TABLE));
+    RW_TABLE rw_table;
+    if (so_table == NULL)
+    {
+        fprintf(stderr, "Unable to allocate split-ordered table\n");
+        exit(EXIT_FAILURE);
+    }
+
+    so_init(so_table, &ebr_domain);
+    rw_init(&rw_table);
+
+    // Initialize thread data:
+    THREAD_ARGS* args = aligned_alloc(WORKER_POOL_ALIGNMENT, NUM_THREADS * sizeof(THREAD_ARGS));
+    if (args == NULL)
+    {
+        fprintf(stderr, "Unable to allocate thread arguments\n");
+        exit(EXIT_FAILURE);
+    }
+
+    for (size_t i = 0U; i < NUM_THREADS; ++i)
+    {
+        args[i] = (THREAD_ARGS) {
+            .thread_i = i,
+            .kind     = kind,
+            .so_table = so_table,
+            .rw_table = &rw_table
+        };
+    }
+
+    double start_ns = worker_pool_time_ns();
+
+    // Submit work to pool workers:
+    for (size_t i = 0U; i < NUM_THREADS; ++i)
+    {
+        worker_pool_submit(pool, i, thread_func, &args[i]);
+    }
+
+    // Wait for all workers to finish execution:
+    worker_pool_wait(pool);
+
+    double elapsed_ns = worker_pool_time_ns() - start_ns;
+
+    // Merge latency histograms:
+    LATENCY_HIST total = {0};
+    uint64_t num_lookups = 0U;
+    uint64_t num_hits    = 0U;
+    uint64_t checksum    = 0U;
+    for (size_t i = 0U; i < NUM_THREADS; ++i)
+    {
+        for (size_t bin = 0U; bin < LATENCY_NUM_BINS; ++bin)
+        {
+            total.bins[bin] += args[i].lookup_latency.bins[bin];
+        }
+
+        total.num_samples += args[i].lookup_latency.num_samples;
+        if (args[i].lookup_latency.max_ns > total.max_ns)
+        {
+            total.max_ns = args[i].lookup_latency.max_ns;
+        }
+
+        num_lookups += args[i].num_lookups;
+        num_hits    += args[i].num_hits;
+        checksum    += args[i].checksum;
+    }
+
+    size_t final_size  = (kind == TABLE_SPLIT_ORDERED)? atomic_load(&so_table->size)  : rw_table.size;
+    size_t final_count = (kind == TABLE_SPLIT_ORDERED)? atomic_load(&so_table->count) : rw_table.count;
+
+    printf("%-14s %7.2f Mops/s  p50 %6lu ns  p99 %6lu ns  p99.9 %7lu ns  max %9lu ns  %8zu keys %8zu buckets\n",
+        TABLE_KIND_NAMES[kind],
+        (double) NUM_THREADS * NUM_ITERATIONS / elapsed_ns * 1e3,
+        latency_percentile(&total, 50.0),
+        latency_percentile(&total, 99.0),
+        latency_percentile(&total, 99.9),
+        total.max_ns,
+        final_count, final_size);
+
+    if (kind == TABLE_RWLOCK_REHASH)
+    {
+        printf("%-14s %zu stop-the-world rehashes, longest %.1f us\n",
+            "", rw_table.num_rehashes, rw_table.max_rehash_ns / 1e3);
+    }
+    else
+    {
+        size_t peak_unreclaimed = 0U;
+        for (size_t i = 0U; i < NUM_THREADS; ++i)
+        {
+            peak_unreclaimed += ebr_domain.records[i].stats.peak_unreclaimed;
+        }
+
+        printf("%-14s incremental resize, %zu nodes peak unreclaimed\n", "", peak_unreclaimed);
+    }
+
+    printf("%-14s hit rate %.2f%%, checksum %lu\n", "",
+        100.0 * num_hits / num_lookups, checksum);
+
+    ebr_free_domain(&ebr_domain);
+    so_free(so_table);
+    rw_free(&rw_table);
+
+    free(so_table);
+    free(args);
+}
+
+int main()
+{
+    // Start persistent worker pool:
+    WORKER_POOL pool;
+    worker_pool_init(&pool, NUM_THREADS, NUM_HARDWARE_THREADS);
+
+    run_benchmark(&pool, TABLE_SPLIT_ORDERED);
+    run_benchmark(&pool, TABLE_RWLOCK_REHASH);
+
+    // Stop worker threads:
+    worker_pool_destroy(&pool);
+
+    return EXIT_SUCCESS;
+}
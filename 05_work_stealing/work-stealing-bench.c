@@ -0,0 +1,261 @@
+// No copyright. Vladislav Alenik, 2024
+
+// Feature test macro:
+#define _GNU_SOURCE
+
+#include "work-stealing.h"
+
+// Pre-created threads for static striping:
+#include "../01_pthreads_sync/worker-pool.h"
+
+// Time measurement:
+#include <time.h>
+
+//======================
+// Benchmark parameters
+//======================
+
+#define NUM_THREADS 8U
+#define NUM_HARDWARE_THREADS 8U
+
+#define NUM_ITEMS 65536U
+
+// Item cost is MIN_ITEM_COST << k, where k is geometrically distributed:
+#define MIN_ITEM_COST 256U
+#define MAX_COST_SHIFT 12U
+
+// Number of items processed by a leaf task:
+#define GRAIN_SIZE 16U
+
+//--------------------
+// Irregular workload
+//--------------------
+
+uint64_t item_cost[NUM_ITEMS];
+
+void init_workload()
+{
+    uint64_t rng = 0xDEADBEEFCAFEBABEULL;
+    for (size_t i = 0U; i < NUM_ITEMS; ++i)
+    {
+        rng ^= rng << 13U;
+        rng ^= rng >> 7U;
+        rng ^= rng << 17U;
+
+        // Heavy tail: every next shift is twice less likely:
+        size_t shift = __builtin_ctzll(rng | (1ULL << MAX_COST_SHIFT));
+
+        item_cost[i] = MIN_ITEM_COST << shift;
+    }
+}
+
+uint64_t process_item(size_t item_i)
+{
+    uint64_t x = item_i + 1U;
+    for (uint64_t iter = 0U; iter < item_cost[item_i]; ++iter)
+    {
+        x ^= x << 13U;
+        x ^= x >> 7U;
+        x ^= x << 17U;
+    }
+
+    return x;
+}
+
+// Results are updated on every item, so keep them on separate cache lines:
+typedef struct {
+    // Result to check that every item is processed exactly once:
+    _Alignas(WS_ALIGNMENT) uint64_t checksum;
+    // Work units done by the thread (load balance metric):
+    uint64_t work_units;
+} THREAD_RESULT;
+
+THREAD_RESULT results[NUM_THREADS];
+
+void process_range(size_t thread_i, size_t begin, size_t end)
+{
+    for (size_t item_i = begin; item_i < end; ++item_i)
+    {
+        results[thread_i].checksum   ^= process_item(item_i);
+        results[thread_i].work_units += item_cost[item_i];
+    }
+}
+
+//----------------------------
+// Static striping (baseline)
+//----------------------------
+
+typedef struct {
+    size_t thread_i;
+} THREAD_ARGS;
+
+void* striping_thread_func(void* thread_args)
+{
+    THREAD_ARGS* args = (THREAD_ARGS*) thread_args;
+
+    for (size_t i = args->thread_i * GRAIN_SIZE; i < NUM_ITEMS; i += NUM_THREADS * GRAIN_SIZE)
+    {
+        size_t end = (i + GRAIN_SIZE < NUM_ITEMS)? i + GRAIN_SIZE : NUM_ITEMS;
+
+        process_range(args->thread_i, i, end);
+    }
+
+    return NULL;
+}
+
+void run_static_striping(WORKER_POOL* pool)
+{
+    // Initialize thread data:
+    THREAD_ARGS args[NUM_THREADS];
+    for (size_t i = 0U; i < NUM_THREADS; ++i)
+    {
+        args[i].thread_i = i;
+    }
+
+    // Submit work to pool workers:
+    for (size_t i = 0U; i < NUM_THREADS; ++i)
+    {
+        worker_pool_submit(pool, i, striping_thread_func, &args[i]);
+    }
+
+    // Wait for all workers to finish execution:
+    worker_pool_wait(pool);
+}
+
+//------------------------------
+// Fork/join with work stealing
+//------------------------------
+
+typedef struct {
+    size_t begin;
+    size_t end;
+} RANGE;
+
+void parallel_range(WS_WORKER* worker, void* range_arg)
+{
+    RANGE* range = (RANGE*) range_arg;
+
+    if (range->end - range->begin <= GRAIN_SIZE)
+    {
+        process_range(worker->worker_i, range->begin, range->end);
+        return;
+    }
+
+    // Fork left half, process right half, then join:
+    size_t mid = range->begin + (range->end - range->begin) / 2U;
+
+    RANGE left  = {.begin = range->begin, .end = mid};
+    RANGE right = {.begin = mid,          .end = range->end};
+
+    WS_TASK left_task;
+    ws_spawn(worker, &left_task, parallel_range, &left);
+
+    parallel_range(worker, &right);
+
+    ws_join(worker, &left_task);
+}
+
+void run_work_stealing(WS_SCHEDULER* scheduler)
+{
+    RANGE whole = {.begin = 0U, .end = NUM_ITEMS};
+
+    ws_run(scheduler, parallel_range, &whole);
+}
+
+//------------------
+// Thread benchmark
+//------------------
+
+double get_time_ns()
+{
+    struct timespec time;
+    clock_gettime(CLOCK_MONOTONIC, &time);
+
+    return 1e9 * time.tv_sec + time.tv_nsec;
+}
+
+void reset_results()
+{
+    for (size_t i = 0U; i < NUM_THREADS; ++i)
+    {
+        results[i].checksum   = 0U;
+        results[i].work_units = 0U;
+    }
+}
+
+uint64_t report_results(const char* name, double elapsed_ns)
+{
+    uint64_t checksum   = 0U;
+    uint64_t total_work = 0U;
+    uint64_t max_work   = 0U;
+    uint64_t min_work   = UINT64_MAX;
+    for (size_t i = 0U; i < NUM_THREADS; ++i)
+    {
+        checksum   ^= results[i].checksum;
+        total_work += results[i].work_units;
+
+        if (results[i].work_units > max_work) max_work = results[i].work_units;
+        if (results[i].work_units < min_work) min_work = results[i].work_units;
+    }
+
+    // Imbalance is how much longer the slowest thread works than an ideal one:
+    double mean_work = (double) total_work / NUM_THREADS;
+
+    printf("%-16s %10.3f ms  imbalance %5.3f  min/max work %5.3f\n",
+        name, elapsed_ns / 1e6, max_work / mean_work, (double) min_work / max_work);
+
+    return checksum;
+}
+
+int main()
+{
+    init_workload();
+
+    // Static striping:
+    // NOTE: both variants run on already started threads, so thread creation is not timed.
+    WORKER_POOL pool;
+    worker_pool_init(&pool, NUM_THREADS, NUM_HARDWARE_THREADS);
+
+    reset_results();
+
+    double start_ns = get_time_ns();
+    run_static_striping(&pool);
+    double elapsed_ns = get_time_ns() - start_ns;
+
+    uint64_t striping_checksum = report_results("static striping", elapsed_ns);
+
+    // Idle pool workers must not compete with the scheduler for hardware threads:
+    worker_pool_destroy(&pool);
+
+    // Work stealing:
+    WS_SCHEDULER scheduler;
+    ws_init(&scheduler, NUM_THREADS, NUM_HARDWARE_THREADS);
+
+    reset_results();
+
+    start_ns = get_time_ns();
+    run_work_stealing(&scheduler);
+    elapsed_ns = get_time_ns() - start_ns;
+
+    uint64_t stealing_checksum = report_results("work stealing", elapsed_ns);
+
+    if (striping_checksum != stealing_checksum)
+    {
+        printf("Checksum mismatch: %lx (striping) vs %lx (stealing)\n",
+            striping_checksum, stealing_checksum);
+        exit(EXIT_FAILURE);
+    }
+
+    // Per-worker scheduler statistics:
+    for (size_t i = 0U; i < NUM_THREADS; ++i)
+    {
+        WS_WORKER* worker = &scheduler.workers[i];
+
+        printf("Worker#%zu: tasks %8lu, steals %6lu, failed steals %8lu, parks %4lu\n",
+            i, worker->num_tasks, worker->num_steals, worker->num_failed_steals, worker->num_parks);
+    }
+
+    ws_destroy(&scheduler);
+
+    return EXIT_SUCCESS;
+}
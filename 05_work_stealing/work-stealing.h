@@ -0,0 +1,508 @@
+// No copyright. Vladislav Alenik, 2024
+#ifndef MSUSEM_WORK_STEALING
+#define MSUSEM_WORK_STEALING
+
+// Feature test macro:
+#define _GNU_SOURCE
+
+#include <stdlib.h>
+#include <stdint.h>
+#include <stdbool.h>
+#include <stdio.h>
+
+// CPU_SET macros:
+#include <sched.h>
+// Threads:
+#include <pthread.h>
+// Atomics:
+#include <stdatomic.h>
+
+//======================
+// Scheduler parameters
+//======================
+
+#define WS_ALIGNMENT 128U
+
+// Initial capacity of a deque (grows on demand):
+#define WS_INITIAL_DEQUE_SIZE 256
+
+// Number of failed search rounds before an idle worker parks:
+#define WS_SPIN_ROUNDS 64U
+
+//================================
+// Chase-Lev work-stealing deque
+// NOTE: "Correct and Efficient
+//  Work-Stealing for Weak Memory
+//  Models", Le et al., PPoPP'13
+//================================
+
+typedef struct WS_WORKER WS_WORKER;
+
+typedef struct {
+    void (*func)(WS_WORKER* worker, void* arg);
+    void* arg;
+    _Atomic bool done;
+} WS_TASK;
+
+typedef struct WS_ARRAY {
+    // Previous (smaller) array kept alive for concurrent thieves:
+    struct WS_ARRAY* prev;
+
+    int64_t size;
+    WS_TASK* _Atomic tasks[];
+} WS_ARRAY;
+
+typedef struct {
+    // Top is shared by thieves, bottom is owned by the worker:
+    _Alignas(WS_ALIGNMENT) _Atomic int64_t top;
+    _Alignas(WS_ALIGNMENT) _Atomic int64_t bottom;
+
+    WS_ARRAY* _Atomic array;
+} WS_DEQUE;
+
+typedef enum {
+    WS_STEAL_SUCCESS = 0,
+    WS_STEAL_EMPTY   = 1,
+    // Lost a race with another thief or the owner:
+    WS_STEAL_ABORT   = 2
+} WS_STEAL_RESULT;
+
+WS_ARRAY* ws_array_alloc(int64_t size, WS_ARRAY* prev)
+{
+    WS_ARRAY* array = malloc(sizeof(WS_ARRAY) + size * sizeof(WS_TASK*));
+    if (array == NULL)
+    {
+        fprintf(stderr, "Unable to allocate deque array of size %ld\n", size);
+        exit(EXIT_FAILURE);
+    }
+
+    array->prev = prev;
+    array->size = size;
+
+    return array;
+}
+
+void ws_deque_init(WS_DEQUE* deque)
+{
+    atomic_init(&deque->top, 0);
+    atomic_init(&deque->bottom, 0);
+    atomic_init(&deque->array, ws_array_alloc(WS_INITIAL_DEQUE_SIZE, NULL));
+}
+
+void ws_deque_free(WS_DEQUE* deque)
+{
+    WS_ARRAY* array = atomic_load_explicit(&deque->array, memory_order_relaxed);
+    while (array != NULL)
+    {
+        WS_ARRAY* prev = array->prev;
+        free(array);
+        array = prev;
+    }
+}
+
+// NOTE: called by the owner only.
+WS_ARRAY* ws_deque_grow(WS_DEQUE* deque, WS_ARRAY* array, int64_t top, int64_t bottom)
+{
+    WS_ARRAY* grown = ws_array_alloc(2 * array->size, array);
+
+    for (int64_t i = top; i < bottom; ++i)
+    {
+        WS_TASK* task = atomic_load_explicit(&array->tasks[i % array->size], memory_order_relaxed);
+        atomic_store_explicit(&grown->tasks[i % grown->size], task, memory_order_relaxed);
+    }
+
+    atomic_store_explicit(&deque->array, grown, memory_order_release);
+
+    return grown;
+}
+
+// NOTE: called by the owner only.
+void ws_deque_push(WS_DEQUE* deque, WS_TASK* task)
+{
+    int64_t bottom = atomic_load_explicit(&deque->bottom, memory_order_relaxed);
+    int64_t top    = atomic_load_explicit(&deque->top, memory_order_acquire);
+
+    WS_ARRAY* array = atomic_load_explicit(&deque->array, memory_order_relaxed);
+    if (bottom - top > array->size - 1)
+    {
+        array = ws_deque_grow(deque, array, top, bottom);
+    }
+
+    atomic_store_explicit(&array->tasks[bottom % array->size], task, memory_order_relaxed);
+
+    atomic_thread_fence(memory_order_release);
+    atomic_store_explicit(&deque->bottom, bottom + 1, memory_order_relaxed);
+}
+
+// NOTE: called by the owner only.
+WS_TASK* ws_deque_take(WS_DEQUE* deque)
+{
+    int64_t bottom = atomic_load_explicit(&deque->bottom, memory_order_relaxed) - 1;
+    WS_ARRAY* array = atomic_load_explicit(&deque->array, memory_order_relaxed);
+
+    atomic_store_explicit(&deque->bottom, bottom, memory_order_relaxed);
+    atomic_thread_fence(memory_order_seq_cst);
+
+    int64_t top = atomic_load_explicit(&deque->top, memory_order_relaxed);
+    if (top > bottom)
+    {
+        // Deque is empty:
+        atomic_store_explicit(&deque->bottom, bottom + 1, memory_order_relaxed);
+        return NULL;
+    }
+
+    WS_TASK* task = atomic_load_explicit(&array->tasks[bottom % array->size], memory_order_relaxed);
+    if (top == bottom)
+    {
+        // Last element, race against thieves:
+        if (!atomic_compare_exchange_strong_explicit(&deque->top, &top, top + 1,
+            memory_order_seq_cst, memory_order_relaxed))
+        {
+            task = NULL;
+        }
+
+        atomic_store_explicit(&deque->bottom, bottom + 1, memory_order_relaxed);
+    }
+
+    return task;
+}
+
+WS_STEAL_RESULT ws_deque_steal(WS_DEQUE* deque, WS_TASK** task)
+{
+    int64_t top = atomic_load_explicit(&deque->top, memory_order_acquire);
+    atomic_thread_fence(memory_order_seq_cst);
+    int64_t bottom = atomic_load_explicit(&deque->bottom, memory_order_acquire);
+
+    if (top >= bottom)
+    {
+        return WS_STEAL_EMPTY;
+    }
+
+    WS_ARRAY* array = atomic_load_explicit(&deque->array, memory_order_acquire);
+    *task = atomic_load_explicit(&array->tasks[top % array->size], memory_order_relaxed);
+
+    if (!atomic_compare_exchange_strong_explicit(&deque->top, &top, top + 1,
+        memory_order_seq_cst, memory_order_relaxed))
+    {
+        return WS_STEAL_ABORT;
+    }
+
+    return WS_STEAL_SUCCESS;
+}
+
+//===================================
+// Fork/join work-stealing scheduler
+//===================================
+
+typedef struct WS_SCHEDULER WS_SCHEDULER;
+
+struct WS_WORKER {
+    _Alignas(WS_ALIGNMENT) WS_DEQUE deque;
+
+    size_t worker_i;
+    WS_SCHEDULER* scheduler;
+
+    // State of xorshift generator for victim selection:
+    uint64_t rng_state;
+
+    // Statistics:
+    uint64_t num_tasks;
+    uint64_t num_steals;
+    uint64_t num_failed_steals;
+    uint64_t num_parks;
+
+    pthread_t tid;
+};
+
+struct WS_SCHEDULER {
+    size_t num_workers;
+    WS_WORKER* workers;
+
+    _Atomic bool shutdown;
+
+    // Idle parking (event count protected by park_mutex):
+    _Alignas(WS_ALIGNMENT) _Atomic size_t num_sleeping;
+    _Atomic uint64_t wake_epoch;
+    pthread_mutex_t park_mutex;
+    pthread_cond_t park_cond;
+};
+
+static inline uint64_t ws_random(WS_WORKER* worker)
+{
+    uint64_t x = worker->rng_state;
+    x ^= x << 13U;
+    x ^= x >> 7U;
+    x ^= x << 17U;
+    worker->rng_state = x;
+
+    return x;
+}
+
+void ws_wake_one(WS_SCHEDULER* scheduler)
+{
+    // Pairs with the seq_cst increment of num_sleeping in ws_park:
+    atomic_thread_fence(memory_order_seq_cst);
+
+    if (atomic_load_explicit(&scheduler->num_sleeping, memory_order_relaxed) == 0U)
+    {
+        return;
+    }
+
+    pthread_mutex_lock(&scheduler->park_mutex);
+    atomic_fetch_add_explicit(&scheduler->wake_epoch, 1U, memory_order_relaxed);
+    pthread_cond_signal(&scheduler->park_cond);
+    pthread_mutex_unlock(&scheduler->park_mutex);
+}
+
+void ws_execute(WS_WORKER* worker, WS_TASK* task)
+{
+    task->func(worker, task->arg);
+
+    worker->num_tasks += 1U;
+
+    atomic_store_explicit(&task->done, true, memory_order_release);
+}
+
+// Take a task from own deque or steal from a random victim:
+WS_TASK* ws_find_task(WS_WORKER* worker)
+{
+    WS_TASK* task = ws_deque_take(&worker->deque);
+    if (task != NULL)
+    {
+        return task;
+    }
+
+    WS_SCHEDULER* scheduler = worker->scheduler;
+    if (scheduler->num_workers == 1U)
+    {
+        return NULL;
+    }
+
+    for (size_t attempt = 0U; attempt < 2U * scheduler->num_workers; ++attempt)
+    {
+        size_t victim_i = ws_random(worker) % (scheduler->num_workers - 1U);
+        if (victim_i >= worker->worker_i)
+        {
+            victim_i += 1U;
+        }
+
+        WS_STEAL_RESULT result = ws_deque_steal(&scheduler->workers[victim_i].deque, &task);
+        if (result == WS_STEAL_SUCCESS)
+        {
+            worker->num_steals += 1U;
+            return task;
+        }
+
+        worker->num_failed_steals += 1U;
+    }
+
+    return NULL;
+}
+
+// Sleep until a new task is spawned:
+// NOTE: returns the task found by the final check (if any).
+WS_TASK* ws_park(WS_WORKER* worker)
+{
+    WS_SCHEDULER* scheduler = worker->scheduler;
+
+    uint64_t epoch = atomic_load_explicit(&scheduler->wake_epoch, memory_order_relaxed);
+    atomic_fetch_add_explicit(&scheduler->num_sleeping, 1U, memory_order_seq_cst);
+
+    // Final check for tasks pushed before num_sleeping became visible:
+    WS_TASK* task = ws_find_task(worker);
+    if (task == NULL)
+    {
+        worker->num_parks += 1U;
+
+        pthread_mutex_lock(&scheduler->park_mutex);
+        while (atomic_load_explicit(&scheduler->wake_epoch, memory_order_relaxed) == epoch &&
+               !atomic_load_explicit(&scheduler->shutdown, memory_order_relaxed))
+        {
+            pthread_cond_wait(&scheduler->park_cond, &scheduler->park_mutex);
+        }
+        pthread_mutex_unlock(&scheduler->park_mutex);
+    }
+
+    atomic_fetch_sub_explicit(&scheduler->num_sleeping, 1U, memory_order_relaxed);
+
+    return task;
+}
+
+void* ws_worker_func(void* worker_arg)
+{
+    WS_WORKER* worker = (WS_WORKER*) worker_arg;
+    WS_SCHEDULER* scheduler = worker->scheduler;
+
+    size_t idle_rounds = 0U;
+    while (!atomic_load_explicit(&scheduler->shutdown, memory_order_acquire))
+    {
+        WS_TASK* task = ws_find_task(worker);
+        if (task == NULL && ++idle_rounds == WS_SPIN_ROUNDS)
+        {
+            idle_rounds = 0U;
+            task = ws_park(worker);
+        }
+
+        if (task != NULL)
+        {
+            idle_rounds = 0U;
+            ws_execute(worker, task);
+        }
+        else
+        {
+            // ASM instruction to ask processor cool down.
+            __asm__ volatile("pause");
+        }
+    }
+
+    return NULL;
+}
+
+// Make task available for stealing:
+// NOTE: task memory must stay valid until ws_join returns.
+void ws_spawn(WS_WORKER* worker, WS_TASK* task, void (*func)(WS_WORKER*, void*), void* arg)
+{
+    task->func = func;
+    task->arg  = arg;
+    atomic_init(&task->done, false);
+
+    ws_deque_push(&worker->deque, task);
+
+    ws_wake_one(worker->scheduler);
+}
+
+// Wait for spawned task, executing other tasks meanwhile:
+void ws_join(WS_WORKER* worker, WS_TASK* task)
+{
+    while (!atomic_load_explicit(&task->done, memory_order_acquire))
+    {
+        WS_TASK* other = ws_find_task(worker);
+        if (other != NULL)
+        {
+            ws_execute(worker, other);
+        }
+        else
+        {
+            // ASM instruction to ask processor cool down.
+            __asm__ volatile("pause");
+        }
+    }
+}
+
+void ws_init(WS_SCHEDULER* scheduler, size_t num_workers, size_t num_hardware_threads)
+{
+    scheduler->num_workers = num_workers;
+
+    scheduler->workers = aligned_alloc(WS_ALIGNMENT, num_workers * sizeof(WS_WORKER));
+    if (scheduler->workers == NULL)
+    {
+        fprintf(stderr, "Unable to allocate %zu workers\n", num_workers);
+        exit(EXIT_FAILURE);
+    }
+
+    atomic_init(&scheduler->shutdown, false);
+    atomic_init(&scheduler->num_sleeping, 0U);
+    atomic_init(&scheduler->wake_epoch, 0U);
+    pthread_mutex_init(&scheduler->park_mutex, NULL);
+    pthread_cond_init(&scheduler->park_cond, NULL);
+
+    for (size_t i = 0U; i < num_workers; ++i)
+    {
+        WS_WORKER* worker = &scheduler->workers[i];
+
+        ws_deque_init(&worker->deque);
+
+        worker->worker_i  = i;
+        worker->scheduler = scheduler;
+        worker->rng_state = 0x9E3779B97F4A7C15ULL * (i + 1U);
+
+        worker->num_tasks         = 0U;
+        worker->num_steals        = 0U;
+        worker->num_failed_steals = 0U;
+        worker->num_parks         = 0U;
+    }
+
+    // Spawn threads:
+    // NOTE: worker#0 is the thread calling ws_run.
+    for (size_t i = 1U; i < num_workers; ++i)
+    {
+        // Initialize thread attributes:
+        pthread_attr_t thread_attributes;
+        int ret = pthread_attr_init(&thread_attributes);
+        if (ret != 0)
+        {
+            fprintf(stderr, "Unable to call pthread_attr_init\n");
+            exit(EXIT_FAILURE);
+        }
+
+        // Assign hardware thread to posix thread:
+        cpu_set_t assigned_harts;
+        CPU_ZERO(&assigned_harts);
+
+        // Assumptions:
+        // - There are num_hardware_threads hardware threads.
+        // - All harts from 0 to are present.
+        size_t hart_i = i % num_hardware_threads;
+        CPU_SET(hart_i, &assigned_harts);
+
+        // Set thread affinity:
+        ret = pthread_attr_setaffinity_np(&thread_attributes, sizeof(cpu_set_t), &assigned_harts);
+        if (ret != 0)
+        {
+            fprintf(stderr, "Unable to call pthread_attr_setaffinity_np\n");
+            exit(EXIT_FAILURE);
+        }
+
+        // Create POSIX thread:
+        ret = pthread_create(&scheduler->workers[i].tid, &thread_attributes, ws_worker_func, &scheduler->workers[i]);
+        if (ret != 0)
+        {
+            fprintf(stderr, "Unable to create thread\n");
+            exit(EXIT_FAILURE);
+        }
+
+        // Destroy thread attribute object:
+        pthread_attr_destroy(&thread_attributes);
+    }
+}
+
+// Run root task on the calling thread (worker#0) until completion:
+void ws_run(WS_SCHEDULER* scheduler, void (*func)(WS_WORKER*, void*), void* arg)
+{
+    WS_WORKER* worker = &scheduler->workers[0];
+
+    WS_TASK root;
+    ws_spawn(worker, &root, func, arg);
+    ws_join(worker, &root);
+}
+
+void ws_destroy(WS_SCHEDULER* scheduler)
+{
+    pthread_mutex_lock(&scheduler->park_mutex);
+    atomic_store_explicit(&scheduler->shutdown, true, memory_order_release);
+    pthread_cond_broadcast(&scheduler->park_cond);
+    pthread_mutex_unlock(&scheduler->park_mutex);
+
+    // Wait for all threads to finish execution:
+    for (size_t i = 1U; i < scheduler->num_workers; ++i)
+    {
+        int ret = pthread_join(scheduler->workers[i].tid, NULL);
+        if (ret != 0)
+        {
+            fprintf(stderr, "Unable to join thread\n");
+            exit(EXIT_FAILURE);
+        }
+    }
+
+    for (size_t i = 0U; i < scheduler->num_workers; ++i)
+    {
+        ws_deque_free(&scheduler->workers[i].deque);
+    }
+
+    pthread_mutex_destroy(&scheduler->park_mutex);
+    pthread_cond_destroy(&scheduler->park_cond);
+
+    free(scheduler->workers);
+}
+
+#endif // MSUSEM_WORK_STEALING
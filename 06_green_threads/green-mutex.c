@@ -0,0 +1,313 @@
+// No copyright. Vladislav Alenik, 2024
+
+// Feature test macro:
+#define _GNU_SOURCE
+
+#include "green-threads.h"
+
+//======================
+// Benchmark parameters
+//======================
+
+#define NUM_CARRIERS 8U
+#define NUM_HARDWARE_THREADS 8U
+
+#define NUM_GREEN_THREADS 10000U
+
+// Same total amount of work as in mutex.c (8 threads x 10M iterations):
+const size_t NUM_ITERATIONS = 8000U;
+
+// Number of green/kernel handoffs to measure switch cost:
+const size_t NUM_SWITCHES = 1000000U;
+
+// Number of kernel threads to measure memory per thread:
+#define NUM_PROBE_PTHREADS 1000U
+
+//-------------------
+// Resident set size
+//-------------------
+
+size_t get_rss_bytes()
+{
+    FILE* statm = fopen("/proc/self/statm", "r");
+    if (statm == NULL)
+    {
+        perror("Unable to open /proc/self/statm");
+        exit(EXIT_FAILURE);
+    }
+
+    size_t total_pages = 0U;
+    size_t rss_pages   = 0U;
+    if (fscanf(statm, "%zu %zu", &total_pages, &rss_pages) != 2)
+    {
+        fprintf(stderr, "Unable to parse /proc/self/statm\n");
+        exit(EXIT_FAILURE);
+    }
+
+    fclose(statm);
+
+    return rss_pages * sysconf(_SC_PAGESIZE);
+}
+
+//---------------------------------
+// Mutex workload on green threads
+//---------------------------------
+
+typedef struct {
+    size_t thread_i;
+    GREEN_MUTEX* mutex;
+} THREAD_ARGS;
+
+// Variable to race on:
+uint32_t var = 0U;
+
+void green_thread_func(void* thread_args)
+{
+    THREAD_ARGS* args = (THREAD_ARGS*) thread_args;
+
+    for (size_t i = 0U; i < NUM_ITERATIONS; ++i)
+    {
+        // Basic critical section among the threads:
+        green_mutex_lock(args->mutex);
+
+        var++;
+
+        green_mutex_unlock(args->mutex);
+    }
+}
+
+void run_green_mutex_workload(WORKER_POOL* pool)
+{
+    GREEN_MUTEX mutex;
+    green_mutex_init(&mutex);
+
+    THREAD_ARGS* args = calloc(NUM_GREEN_THREADS, sizeof(THREAD_ARGS));
+    if (args == NULL)
+    {
+        fprintf(stderr, "Unable to allocate thread arguments\n");
+        exit(EXIT_FAILURE);
+    }
+
+    size_t rss_before = get_rss_bytes();
+
+    // Spawn green threads:
+    GREEN_RUNTIME runtime;
+    green_runtime_init(&runtime, NUM_CARRIERS, NUM_GREEN_THREADS);
+
+    for (size_t i = 0U; i < NUM_GREEN_THREADS; ++i)
+    {
+        args[i].thread_i = i;
+        args[i].mutex    = &mutex;
+
+        green_spawn(&runtime, green_thread_func, &args[i]);
+    }
+
+    double start_ns = worker_pool_time_ns();
+    green_run(&runtime, pool);
+    double elapsed_ns = worker_pool_time_ns() - start_ns;
+
+    // Stacks are still mapped, so RSS includes all the pages touched by tasks:
+    size_t rss_after = get_rss_bytes();
+
+    uint64_t num_switches = 0U;
+    uint64_t num_steals   = 0U;
+    for (size_t i = 0U; i < NUM_CARRIERS; ++i)
+    {
+        num_switches += runtime.carriers[i].num_switches;
+        num_steals   += runtime.carriers[i].num_steals;
+    }
+
+    printf("Result of the computation: %u\n", var);
+    printf("Green mutex workload:   %10.3f ms (%.1f ns/lock, %lu switches, %lu steals)\n",
+        elapsed_ns / 1e6, elapsed_ns / ((double) NUM_GREEN_THREADS * NUM_ITERATIONS),
+        num_switches, num_steals);
+    printf("Green thread memory:    %10.1f KiB RSS/task (%u KiB stack reserved)\n",
+        (double) (rss_after - rss_before) / NUM_GREEN_THREADS / 1024.0,
+        (GREEN_STACK_SIZE + GREEN_GUARD_SIZE) / 1024U);
+
+    green_runtime_free(&runtime);
+    free(args);
+}
+
+//------------------------
+// Green switch ping-pong
+//------------------------
+
+void green_ping_pong_func(void* arg)
+{
+    (void) arg;
+
+    for (size_t i = 0U; i < NUM_SWITCHES / 2U; ++i)
+    {
+        green_yield();
+    }
+}
+
+double measure_green_switch(WORKER_POOL* pool)
+{
+    // Two green threads on a single carrier:
+    GREEN_RUNTIME runtime;
+    green_runtime_init(&runtime, 1U, 2U);
+
+    green_spawn(&runtime, green_ping_pong_func, NULL);
+    green_spawn(&runtime, green_ping_pong_func, NULL);
+
+    double start_ns = worker_pool_time_ns();
+    green_run(&runtime, pool);
+    double elapsed_ns = worker_pool_time_ns() - start_ns;
+
+    green_runtime_free(&runtime);
+
+    return elapsed_ns / NUM_SWITCHES;
+}
+
+//-------------------------
+// Kernel switch ping-pong
+//-------------------------
+
+typedef struct {
+    size_t thread_i;
+    POOL_EVENT* turn;
+} PING_PONG_ARGS;
+
+void* kernel_ping_pong_func(void* thread_args)
+{
+    PING_PONG_ARGS* args = (PING_PONG_ARGS*) thread_args;
+
+    for (size_t i = 0U; i < NUM_SWITCHES / 2U; ++i)
+    {
+        // Wait for own turn:
+        uint32_t turn;
+        while ((turn = atomic_load_explicit(&args->turn->value, memory_order_acquire)) % 2U != args->thread_i)
+        {
+            pool_event_wait(args->turn, turn, 0U);
+        }
+
+        // Hand off to the other thread:
+        atomic_fetch_add_explicit(&args->turn->value, 1U, memory_order_release);
+        pool_event_wake(args->turn);
+    }
+
+    return NULL;
+}
+
+double measure_kernel_switch()
+{
+    // Two kernel threads on the same hardware thread:
+    WORKER_POOL pool;
+    worker_pool_init(&pool, 2U, 1U);
+
+    POOL_EVENT turn;
+    pool_event_init(&turn, 0U);
+
+    PING_PONG_ARGS args[2U] = {
+        {.thread_i = 0U, .turn = &turn},
+        {.thread_i = 1U, .turn = &turn}
+    };
+
+    double start_ns = worker_pool_time_ns();
+
+    worker_pool_submit(&pool, 0U, kernel_ping_pong_func, &args[0U]);
+    worker_pool_submit(&pool, 1U, kernel_ping_pong_func, &args[1U]);
+    worker_pool_wait(&pool);
+
+    double elapsed_ns = worker_pool_time_ns() - start_ns;
+
+    worker_pool_destroy(&pool);
+
+    return elapsed_ns / NUM_SWITCHES;
+}
+
+//----------------------
+// Kernel thread memory
+//----------------------
+
+void* probe_thread_func(void* barrier)
+{
+    // Keep thread alive until RSS is measured:
+    pthread_barrier_wait((pthread_barrier_t*) barrier);
+    pthread_barrier_wait((pthread_barrier_t*) barrier);
+
+    return NULL;
+}
+
+void measure_kernel_thread_memory()
+{
+    pthread_barrier_t barrier;
+    pthread_barrier_init(&barrier, NULL, NUM_PROBE_PTHREADS + 1U);
+
+    pthread_t* tids = calloc(NUM_PROBE_PTHREADS, sizeof(pthread_t));
+    if (tids == NULL)
+    {
+        fprintf(stderr, "Unable to allocate thread ids\n");
+        exit(EXIT_FAILURE);
+    }
+
+    size_t rss_before = get_rss_bytes();
+
+    // Spawn threads with default attributes:
+    for (size_t i = 0U; i < NUM_PROBE_PTHREADS; ++i)
+    {
+        int ret = pthread_create(&tids[i], NULL, probe_thread_func, &barrier);
+        if (ret != 0)
+        {
+            fprintf(stderr, "Unable to create thread\n");
+            exit(EXIT_FAILURE);
+        }
+    }
+
+    pthread_barrier_wait(&barrier);
+
+    size_t rss_after = get_rss_bytes();
+
+    pthread_barrier_wait(&barrier);
+
+    // Wait for all threads to finish execution:
+    for (size_t i = 0; i < NUM_PROBE_PTHREADS; ++i)
+    {
+        int ret = pthread_join(tids[i], NULL);
+        if (ret != 0)
+        {
+            fprintf(stderr, "Unable to join thread\n");
+            exit(EXIT_FAILURE);
+        }
+    }
+
+    // Default stack reservation:
+    pthread_attr_t attributes;
+    pthread_attr_init(&attributes);
+
+    size_t stack_size = 0U;
+    pthread_attr_getstacksize(&attributes, &stack_size);
+    pthread_attr_destroy(&attributes);
+
+    // NOTE: kernel stack and task_struct are not accounted in RSS.
+    printf("Kernel thread memory:   %10.1f KiB RSS/task (%zu KiB stack reserved)\n",
+        (double) (rss_after - rss_before) / NUM_PROBE_PTHREADS / 1024.0,
+        stack_size / 1024U);
+
+    pthread_barrier_destroy(&barrier);
+    free(tids);
+}
+
+//------------------
+// Thread benchmark
+//------------------
+
+int main()
+{
+    // Start carrier threads:
+    WORKER_POOL pool;
+    worker_pool_init(&pool, NUM_CARRIERS, NUM_HARDWARE_THREADS);
+
+    run_green_mutex_workload(&pool);
+
+    printf("Green thread handoff:   %10.1f ns\n", measure_green_switch(&pool));
+    printf("Kernel thread handoff:  %10.1f ns\n", measure_kernel_switch());
+
+    measure_kernel_thread_memory();
+
+    worker_pool_destroy(&pool);
+
+    return EXIT_SUCCESS;
+}
@@ -0,0 +1,486 @@
+// No copyright. Vladislav Alenik, 2024
+#ifndef MSUSEM_GREEN_THREADS
+#define MSUSEM_GREEN_THREADS
+
+// Feature test macro:
+#define _GNU_SOURCE
+
+#include <stdlib.h>
+#include <stdint.h>
+#include <stdbool.h>
+#include <stdio.h>
+
+// Atomics:
+#include <stdatomic.h>
+// Stack allocation:
+#include <sys/mman.h>
+#include <unistd.h>
+// Carrier threads:
+#include "../01_pthreads_sync/worker-pool.h"
+
+//=========================
+// Green thread parameters
+//=========================
+
+// Usable stack size of a single green thread:
+#define GREEN_STACK_SIZE (16U * 1024U)
+
+// Guard page below every stack catches overflows:
+#define GREEN_GUARD_SIZE 4096U
+
+// Maximal number of carrier (kernel) threads:
+#define GREEN_MAX_CARRIERS 64U
+
+// Number of failed lock attempts before yielding to the scheduler:
+#define GREEN_MUTEX_SPINS 16U
+
+//======================================
+// Context switch (x86-64 System V ABI)
+//======================================
+
+// Context is just a saved stack pointer:
+// NOTE: callee-saved registers, MXCSR and x87 control word are kept on the stack.
+typedef struct {
+    void* rsp;
+} GREEN_CONTEXT;
+
+// Save current context into "from" and resume "to":
+void green_switch(GREEN_CONTEXT* from, GREEN_CONTEXT* to);
+
+__asm__(
+    ".text\n"
+    ".globl green_switch\n"
+    ".type green_switch, @function\n"
+    "green_switch:\n"
+    // Save callee-saved registers of the current context:
+    "    pushq %rbp\n"
+    "    pushq %rbx\n"
+    "    pushq %r12\n"
+    "    pushq %r13\n"
+    "    pushq %r14\n"
+    "    pushq %r15\n"
+    // Save floating-point control state:
+    "    subq $8, %rsp\n"
+    "    stmxcsr (%rsp)\n"
+    "    fnstcw 4(%rsp)\n"
+    // Swap stacks:
+    "    movq %rsp, (%rdi)\n"
+    "    movq (%rsi), %rsp\n"
+    // Restore the context being resumed:
+    "    ldmxcsr (%rsp)\n"
+    "    fldcw 4(%rsp)\n"
+    "    addq $8, %rsp\n"
+    "    popq %r15\n"
+    "    popq %r14\n"
+    "    popq %r13\n"
+    "    popq %r12\n"
+    "    popq %rbx\n"
+    "    popq %rbp\n"
+    "    ret\n"
+    ".size green_switch, .-green_switch\n"
+);
+
+//==========================
+// Green threads and queues
+//==========================
+
+typedef enum {
+    GREEN_RUNNABLE = 0,
+    GREEN_RUNNING  = 1,
+    GREEN_DONE     = 2
+} GREEN_STATE;
+
+typedef struct GREEN_TASK {
+    GREEN_CONTEXT context;
+
+    // Run queue link:
+    struct GREEN_TASK* next;
+
+    void (*func)(void* arg);
+    void* arg;
+
+    GREEN_STATE state;
+
+    // Stack mapping (guard page included):
+    uint8_t* stack_map;
+    size_t stack_map_size;
+} GREEN_TASK;
+
+// Intrusive FIFO protected by a test-and-set spinlock:
+typedef struct {
+    atomic_flag lock;
+
+    GREEN_TASK* head;
+    GREEN_TASK* tail;
+} GREEN_QUEUE;
+
+void green_queue_lock(GREEN_QUEUE* queue)
+{
+    while (atomic_flag_test_and_set_explicit(&queue->lock, memory_order_acquire))
+    {
+        // ASM instruction to ask processor cool down.
+        __asm__ volatile("pause");
+    }
+}
+
+void green_queue_unlock(GREEN_QUEUE* queue)
+{
+    atomic_flag_clear_explicit(&queue->lock, memory_order_release);
+}
+
+void green_queue_push(GREEN_QUEUE* queue, GREEN_TASK* task)
+{
+    task->next = NULL;
+
+    green_queue_lock(queue);
+
+    if (queue->tail == NULL)
+    {
+        queue->head = task;
+    }
+    else
+    {
+        queue->tail->next = task;
+    }
+    queue->tail = task;
+
+    green_queue_unlock(queue);
+}
+
+GREEN_TASK* green_queue_pop(GREEN_QUEUE* queue)
+{
+    green_queue_lock(queue);
+
+    GREEN_TASK* task = queue->head;
+    if (task != NULL)
+    {
+        queue->head = task->next;
+        if (queue->head == NULL)
+        {
+            queue->tail = NULL;
+        }
+    }
+
+    green_queue_unlock(queue);
+
+    return task;
+}
+
+//===================
+// M:N green runtime
+//===================
+
+typedef struct GREEN_RUNTIME GREEN_RUNTIME;
+
+typedef struct {
+    _Alignas(WORKER_POOL_ALIGNMENT) GREEN_QUEUE run_queue;
+
+    // Context of the carrier's scheduler loop:
+    GREEN_CONTEXT scheduler_context;
+    GREEN_TASK* current;
+
+    size_t carrier_i;
+    GREEN_RUNTIME* runtime;
+
+    // Statistics:
+    uint64_t num_switches;
+    uint64_t num_steals;
+} GREEN_CARRIER;
+
+struct GREEN_RUNTIME {
+    size_t num_carriers;
+    GREEN_CARRIER carriers[GREEN_MAX_CARRIERS];
+
+    // Tasks are kept until green_runtime_free (their stacks are measured):
+    GREEN_TASK** tasks;
+    size_t num_tasks;
+    size_t max_tasks;
+
+    _Alignas(WORKER_POOL_ALIGNMENT) _Atomic size_t num_live_tasks;
+
+    // Round-robin placement of tasks spawned from outside the runtime:
+    size_t next_carrier;
+};
+
+static _Thread_local GREEN_CARRIER* green_carrier_self = NULL;
+
+// NOTE: green threads migrate between carriers, so TLS address must not be cached.
+__attribute__((noinline))
+GREEN_CARRIER* green_current_carrier()
+{
+    __asm__ volatile("" ::: "memory");
+    return green_carrier_self;
+}
+
+void green_runtime_init(GREEN_RUNTIME* runtime, size_t num_carriers, size_t max_tasks)
+{
+    if (num_carriers == 0U || num_carriers > GREEN_MAX_CARRIERS)
+    {
+        fprintf(stderr, "Invalid number of carriers: %zu\n", num_carriers);
+        exit(EXIT_FAILURE);
+    }
+
+    runtime->num_carriers = num_carriers;
+
+    for (size_t i = 0U; i < num_carriers; ++i)
+    {
+        GREEN_CARRIER* carrier = &runtime->carriers[i];
+
+        atomic_flag_clear(&carrier->run_queue.lock);
+        carrier->run_queue.head = NULL;
+        carrier->run_queue.tail = NULL;
+
+        carrier->current   = NULL;
+        carrier->carrier_i = i;
+        carrier->runtime   = runtime;
+
+        carrier->num_switches = 0U;
+        carrier->num_steals   = 0U;
+    }
+
+    runtime->tasks = calloc(max_tasks, sizeof(GREEN_TASK*));
+    if (runtime->tasks == NULL)
+    {
+        fprintf(stderr, "Unable to allocate task table of %zu entries\n", max_tasks);
+        exit(EXIT_FAILURE);
+    }
+
+    runtime->num_tasks = 0U;
+    runtime->max_tasks = max_tasks;
+
+    atomic_init(&runtime->num_live_tasks, 0U);
+
+    runtime->next_carrier = 0U;
+}
+
+void green_runtime_free(GREEN_RUNTIME* runtime)
+{
+    for (size_t i = 0U; i < runtime->num_tasks; ++i)
+    {
+        GREEN_TASK* task = runtime->tasks[i];
+
+        munmap(task->stack_map, task->stack_map_size);
+        free(task);
+    }
+
+    free(runtime->tasks);
+}
+
+// Entry point of every green thread:
+__attribute__((noreturn))
+void green_trampoline()
+{
+    GREEN_TASK* task = green_current_carrier()->current;
+
+    task->func(task->arg);
+
+    task->state = GREEN_DONE;
+
+    // Thread may have migrated to another carrier:
+    green_switch(&task->context, &green_current_carrier()->scheduler_context);
+
+    __builtin_unreachable();
+}
+
+// NOTE: tasks are spawned before green_run by the main thread.
+GREEN_TASK* green_spawn(GREEN_RUNTIME* runtime, void (*func)(void*), void* arg)
+{
+    if (runtime->num_tasks == runtime->max_tasks)
+    {
+        fprintf(stderr, "Too many green threads (max %zu)\n", runtime->max_tasks);
+        exit(EXIT_FAILURE);
+    }
+
+    GREEN_TASK* task = malloc(sizeof(GREEN_TASK));
+    if (task == NULL)
+    {
+        fprintf(stderr, "Unable to allocate green thread\n");
+        exit(EXIT_FAILURE);
+    }
+
+    // Allocate stack with a guard page at the bottom:
+    task->stack_map_size = GREEN_STACK_SIZE + GREEN_GUARD_SIZE;
+    task->stack_map = mmap(NULL, task->stack_map_size, PROT_READ|PROT_WRITE,
+        MAP_PRIVATE|MAP_ANONYMOUS|MAP_NORESERVE, -1, 0);
+    if (task->stack_map == MAP_FAILED)
+    {
+        perror("Unable to map green thread stack");
+        exit(EXIT_FAILURE);
+    }
+
+    if (mprotect(task->stack_map, GREEN_GUARD_SIZE, PROT_NONE) == -1)
+    {
+        perror("Unable to protect stack guard page");
+        exit(EXIT_FAILURE);
+    }
+
+    // Build initial frame consumed by green_switch:
+    // [top - 8]  fake return address of green_trampoline
+    // [top - 16] green_trampoline (16-byte aligned, as after a call)
+    // [top - 64] rbp, rbx, r12-r15
+    // [top - 72] MXCSR and x87 control word
+    uint64_t* top = (uint64_t*) (task->stack_map + task->stack_map_size);
+
+    top[-1] = 0U;
+    top[-2] = (uint64_t) green_trampoline;
+    for (size_t reg_i = 3U; reg_i <= 8U; ++reg_i)
+    {
+        top[-reg_i] = 0U;
+    }
+
+    // Default MXCSR (0x1F80) and x87 control word (0x037F):
+    top[-9] = 0x1F80ULL | (0x037FULL << 32U);
+
+    task->context.rsp = &top[-9];
+
+    task->func  = func;
+    task->arg   = arg;
+    task->state = GREEN_RUNNABLE;
+
+    runtime->tasks[runtime->num_tasks++] = task;
+    atomic_fetch_add_explicit(&runtime->num_live_tasks, 1U, memory_order_relaxed);
+
+    green_queue_push(&runtime->carriers[runtime->next_carrier].run_queue, task);
+    runtime->next_carrier = (runtime->next_carrier + 1U) % runtime->num_carriers;
+
+    return task;
+}
+
+// Give up the carrier to another runnable green thread:
+void green_yield()
+{
+    GREEN_CARRIER* carrier = green_current_carrier();
+    GREEN_TASK* task = carrier->current;
+
+    task->state = GREEN_RUNNABLE;
+
+    green_switch(&task->context, &carrier->scheduler_context);
+}
+
+GREEN_TASK* green_pick_task(GREEN_CARRIER* carrier)
+{
+    GREEN_TASK* task = green_queue_pop(&carrier->run_queue);
+    if (task != NULL)
+    {
+        return task;
+    }
+
+    // Steal from other carriers:
+    GREEN_RUNTIME* runtime = carrier->runtime;
+    for (size_t i = 1U; i < runtime->num_carriers; ++i)
+    {
+        GREEN_CARRIER* victim = &runtime->carriers[(carrier->carrier_i + i) % runtime->num_carriers];
+
+        task = green_queue_pop(&victim->run_queue);
+        if (task != NULL)
+        {
+            carrier->num_steals += 1U;
+            return task;
+        }
+    }
+
+    return NULL;
+}
+
+// Scheduler loop executed by every carrier thread:
+void* green_carrier_func(void* carrier_arg)
+{
+    GREEN_CARRIER* carrier = (GREEN_CARRIER*) carrier_arg;
+    GREEN_RUNTIME* runtime = carrier->runtime;
+
+    green_carrier_self = carrier;
+
+    while (atomic_load_explicit(&runtime->num_live_tasks, memory_order_acquire) != 0U)
+    {
+        GREEN_TASK* task = green_pick_task(carrier);
+        if (task == NULL)
+        {
+            // All live tasks are running on other carriers:
+            sched_yield();
+            continue;
+        }
+
+        task->state = GREEN_RUNNING;
+        carrier->current = task;
+
+        green_switch(&carrier->scheduler_context, &task->context);
+
+        carrier->current = NULL;
+        carrier->num_switches += 1U;
+
+        // Task has switched out completely, so it's safe to publish it:
+        if (task->state == GREEN_DONE)
+        {
+            atomic_fetch_sub_explicit(&runtime->num_live_tasks, 1U, memory_order_release);
+        }
+        else
+        {
+            green_queue_push(&carrier->run_queue, task);
+        }
+    }
+
+    green_carrier_self = NULL;
+
+    return NULL;
+}
+
+// Run all spawned green threads to completion on pool workers:
+void green_run(GREEN_RUNTIME* runtime, WORKER_POOL* pool)
+{
+    if (pool->num_workers < runtime->num_carriers)
+    {
+        fprintf(stderr, "Not enough pool workers (%zu) for %zu carriers\n",
+            pool->num_workers, runtime->num_carriers);
+        exit(EXIT_FAILURE);
+    }
+
+    for (size_t i = 0U; i < runtime->num_carriers; ++i)
+    {
+        worker_pool_submit(pool, i, green_carrier_func, &runtime->carriers[i]);
+    }
+
+    worker_pool_wait(pool);
+}
+
+//=============================
+// Mutex yielding to scheduler
+//=============================
+
+typedef struct {
+    _Atomic bool locked;
+} GREEN_MUTEX;
+
+void green_mutex_init(GREEN_MUTEX* mutex)
+{
+    atomic_init(&mutex->locked, false);
+}
+
+void green_mutex_lock(GREEN_MUTEX* mutex)
+{
+    for (uint32_t attempt = 1U; true; ++attempt)
+    {
+        if (!atomic_load_explicit(&mutex->locked, memory_order_relaxed) &&
+            !atomic_exchange_explicit(&mutex->locked, true, memory_order_acquire))
+        {
+            return;
+        }
+
+        if (attempt % GREEN_MUTEX_SPINS == 0U)
+        {
+            // Lock holder runs on another carrier, let others make progress:
+            green_yield();
+        }
+        else
+        {
+            // ASM instruction to ask processor cool down.
+            __asm__ volatile("pause");
+        }
+    }
+}
+
+void green_mutex_unlock(GREEN_MUTEX* mutex)
+{
+    atomic_store_explicit(&mutex->locked, false, memory_order_release);
+}
+
+#endif // MSUSEM_GREEN_THREADS